@@ -0,0 +1,156 @@
+#include "../src/graphics/framebuffer.h"
+#include "../src/graphics/memory_render_target.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <thread>
+
+#define SCREEN_WIDTH 1920
+#define SCREEN_HEIGHT 1080
+#define SCENE_POLYGONS 3000
+
+/* Benchmark of banded rasterization at increasing raster thread counts. With
+--check it compares the frames rendered by several threads with one thread's
+instead.
+Usage: bench_bands [--check] */
+
+/* Current monotonic time in nanoseconds */
+static double Now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/* Print one result line */
+static void Report(int threads, const char *op, double ns_per_call, double pixels_per_call, double baseline_ns) {
+  printf("threads=%-3d op=%-10s ns_per_call=%12.0f mpixels_per_s=%10.1f speedup=%5.2f\n", threads, op, ns_per_call, pixels_per_call * 1e3 / ns_per_call, baseline_ns / ns_per_call);
+}
+
+/* A map-like sprite of overlapping quads covering the whole screen */
+static Sprite MakeScene(int width = SCREEN_WIDTH, int height = SCREEN_HEIGHT, int polygons = SCENE_POLYGONS) {
+  Sprite scene;
+  srand(1);
+  for (int i = 0; i < polygons; i++) {
+    int x = rand() % width;
+    int y = rand() % height;
+    int w = 20 + rand() % 180;
+    int h = 20 + rand() % 180;
+    Polygon quad;
+    quad.AddPoint(Point(x, y));
+    quad.AddPoint(Point(x + w, y + h / 4));
+    quad.AddPoint(Point(x + w - w / 4, y + h));
+    quad.AddPoint(Point(x - w / 4, y + h - h / 4));
+    scene.AddPolygon(quad, Color(rand() % 256, rand() % 256, rand() % 256), COLOR_WHITE);
+  }
+  return scene;
+}
+
+/* Render a frame of scenes, moved scenes, lines, circles and rectangles
+clipped to random rectangles on a screen whose height does not split evenly
+into bands, with each thread count, and compare the frames with the one
+thread frame. Returns the number of failures */
+static int Check() {
+  const int width = 397;
+  const int height = 211;
+  const int thread_counts[] = {1, 2, 3, 4, 8};
+  Sprite scene = MakeScene(width, height, 300);
+  std::vector<uint8_t> single;
+  int failures = 0;
+  for (unsigned i = 0; i < sizeof(thread_counts) / sizeof(thread_counts[0]); i++) {
+    MemoryRenderTarget *target = new MemoryRenderTarget(width, height);
+    Framebuffer fb(target);
+    fb.SetDamageMode(DAMAGE_OFF);
+    fb.SetRasterThreads(thread_counts[i]);
+    srand(2);
+    fb.Clear();
+    for (int j = 0; j < 20; j++) {
+      Point top_left(rand() % width - 20, rand() % height - 20);
+      Point bottom_right(top_left.GetX() + rand() % width, top_left.GetY() + rand() % height);
+      Point pivot(rand() % width, rand() % height);
+      Color color(rand() % 256, rand() % 256, rand() % 256);
+      switch (j % 5) {
+        case 0:
+          fb.DrawClippedSprite(scene, top_left, bottom_right, rand() % 40 - 20, rand() % 40 - 20);
+          break;
+        case 1:
+          fb.DrawClippedSprite(scene, Transform2D::Rotation(pivot, rand() % 3600 / 10.0).Then(Transform2D::Scaling(pivot, 0.5 + rand() % 100 / 100.0)), top_left, bottom_right);
+          break;
+        case 2:
+          for (int k = 0; k < 50; k++) {
+            fb.ClipLine(Point(rand() % (2 * width) - width / 2, rand() % (2 * height) - height / 2), Point(rand() % (2 * width) - width / 2, rand() % (2 * height) - height / 2), top_left, bottom_right, color);
+          }
+          break;
+        case 3:
+          fb.DrawFilledCircle(pivot, rand() % 80, COLOR_WHITE, color);
+          fb.DrawCircle(pivot, rand() % 120, color);
+          break;
+        default:
+          fb.FillRect(top_left, bottom_right, color);
+          break;
+      }
+    }
+    fb.Display();
+    std::vector<uint8_t> screen(target->GetMemory(), target->GetMemory() + target->GetMemorySize());
+    if (thread_counts[i] == 1) {
+      single = screen;
+    } else {
+      int thread_failures = screen != single;
+      printf("check op=scene threads=%-3d failures=%d\n", thread_counts[i], thread_failures);
+      failures += thread_failures;
+    }
+  }
+  return failures;
+}
+
+int main(int argc, char *argv[]) {
+  if (argc > 1 && strcmp(argv[1], "--check") == 0) {
+    int failures = Check();
+    printf("check bench_bands: %s\n", failures ? "FAILED" : "ok");
+    return failures ? 1 : 0;
+  }
+
+  Framebuffer fb(new MemoryRenderTarget(SCREEN_WIDTH, SCREEN_HEIGHT));
+  fb.SetDamageMode(DAMAGE_OFF);
+  const double screen_pixels = (double) SCREEN_WIDTH * SCREEN_HEIGHT;
+  Sprite scene = MakeScene();
+  Point top_left(0, 0);
+  Point bottom_right(SCREEN_WIDTH - 1, SCREEN_HEIGHT - 1);
+
+  /* Build the edge tables before timing */
+  fb.DrawClippedSprite(scene, top_left, bottom_right);
+
+  int thread_counts[] = {1, 2, 4, 8, 16};
+  int cores = std::thread::hardware_concurrency();
+  printf("hardware_threads=%d\n", cores);
+
+  double clear_baseline = 0;
+  double sprite_baseline = 0;
+  for (unsigned i = 0; i < sizeof(thread_counts) / sizeof(thread_counts[0]); i++) {
+    int threads = thread_counts[i];
+    fb.SetRasterThreads(threads);
+
+    int iterations = 200;
+    double start = Now();
+    for (int j = 0; j < iterations; j++) {
+      fb.Clear();
+    }
+    double ns = (Now() - start) / iterations;
+    if (threads == 1) {
+      clear_baseline = ns;
+    }
+    Report(threads, "clear", ns, screen_pixels, clear_baseline);
+
+    iterations = 20;
+    start = Now();
+    for (int j = 0; j < iterations; j++) {
+      fb.DrawClippedSprite(scene, top_left, bottom_right);
+    }
+    ns = (Now() - start) / iterations;
+    if (threads == 1) {
+      sprite_baseline = ns;
+    }
+    Report(threads, "scene", ns, screen_pixels, sprite_baseline);
+  }
+  return 0;
+}
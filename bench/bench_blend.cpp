@@ -0,0 +1,213 @@
+#include "../src/graphics/framebuffer.h"
+#include "../src/graphics/memory_render_target.h"
+#include "../src/graphics/pixel_kernels.h"
+#include "../src/graphics/layer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+
+#define SCREEN_WIDTH 1920
+#define SCREEN_HEIGHT 1080
+
+/* Benchmark of blended draws against the same opaque draws, at every
+supported instruction set. With --check it compares the blend kernels with
+the blend formula and every instruction set with the scalar path instead */
+
+/* Current monotonic time in nanoseconds */
+static double Now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/* Print one result line */
+static void Report(const char *kernel, const char *op, double ns_per_call, double pixels_per_call, double opaque_ns) {
+  printf("kernel=%-6s op=%-16s ns_per_call=%12.0f mpixels_per_s=%10.1f vs_opaque=%5.2f\n", kernel, op, ns_per_call, pixels_per_call * 1e3 / ns_per_call, ns_per_call / opaque_ns);
+}
+
+/* Time iterations of a 64x64 fill of color at a moving position */
+static double TimeSmallFills(Framebuffer& fb, const Color& color, int iterations) {
+  double start = Now();
+  for (int i = 0; i < iterations; i++) {
+    int x = (i * 37) % (SCREEN_WIDTH - 64);
+    int y = (i * 91) % (SCREEN_HEIGHT - 64);
+    fb.FillRect(Point(x, y), Point(x + 63, y + 63), color);
+  }
+  return (Now() - start) / iterations;
+}
+
+/* Time iterations of a whole screen fill of color */
+static double TimeScreenFills(Framebuffer& fb, const Color& color, int iterations) {
+  double start = Now();
+  for (int i = 0; i < iterations; i++) {
+    fb.FillRect(Point(0, 0), Point(SCREEN_WIDTH - 1, SCREEN_HEIGHT - 1), color);
+  }
+  return (Now() - start) / iterations;
+}
+
+/* Time iterations of a filled 200 pixel wide diamond */
+static double TimePolygons(Framebuffer& fb, const Polygon& diamond, const Color& color, int iterations) {
+  Point top_left(0, 0);
+  Point bottom_right(SCREEN_WIDTH - 1, SCREEN_HEIGHT - 1);
+  double start = Now();
+  for (int i = 0; i < iterations; i++) {
+    fb.DrawRasteredPolygon(diamond, color, color, top_left, bottom_right, (i * 37) % (SCREEN_WIDTH - 200), (i * 91) % (SCREEN_HEIGHT - 200));
+  }
+  return (Now() - start) / iterations;
+}
+
+/* Bytes around the checked range that a kernel must leave alone */
+#define GUARD_BYTES 64
+
+/* round((color * a + pixel * (255 - a)) / 255) per channel, with the alpha
+of the color counted as 255, as PixelKernels::BlendPixel documents it */
+static uint32_t BlendExact(uint32_t pixel, uint32_t color) {
+  uint32_t a = color >> 24;
+  uint32_t result = 0;
+  for (int shift = 0; shift < 32; shift += 8) {
+    uint32_t source = shift == 24 ? 255 : (color >> shift) & 0xff;
+    uint32_t destination = (pixel >> shift) & 0xff;
+    result |= ((source * a + destination * (255 - a) + 127) / 255) << shift;
+  }
+  return result;
+}
+
+/* Blend a random color or a random layer over a random buffer at every
+instruction set, at dst offsets 0 to 60 bytes past a 64 byte boundary and
+lengths 0 to 130 plus two large ones. The scalar path must follow the blend
+formula, and every level must leave the whole buffer, guards included, as the
+scalar path does. Alphas are drawn from 0, 255 and anything between, as the
+kernels take shortcuts for the first two. Returns the number of failures */
+static int Check() {
+  const long lengths[] = {1000, 4099};
+  std::vector<uint8_t> initial(2 * GUARD_BYTES + 4 * 4099 + 64);
+  std::vector<uint8_t> layer(initial.size());
+  std::vector<uint8_t> scalar(initial.size());
+  std::vector<uint8_t> simd(initial.size());
+  int failures = 0;
+  srand(1);
+  /* Layer pixels come in runs of 16 that are all transparent, all opaque or
+  mixed, so that the shortcuts for whole vectors of each are taken */
+  int run_mode = 0;
+  for (unsigned i = 0; i < initial.size(); i++) {
+    if (i % 64 == 0) {
+      run_mode = rand() % 3;
+    }
+    initial[i] = rand();
+    layer[i] = rand();
+    if (i % 4 == 3 && run_mode < 2) {
+      layer[i] = run_mode == 0 ? 0 : 255;
+    }
+  }
+
+  /* The scalar kernels against the formula */
+  int formula_failures = 0;
+  for (int i = 0; i < 1000000; i++) {
+    uint32_t pixel = ((uint32_t) rand() << 16) ^ rand();
+    uint32_t color = ((uint32_t) rand() << 16) ^ rand();
+    if (PixelKernels::BlendPixel(pixel, color) != BlendExact(pixel, color)) {
+      formula_failures++;
+    }
+  }
+  printf("check op=%-11s kernel=%-6s failures=%d\n", "blend_pixel", "scalar", formula_failures);
+  failures += formula_failures;
+
+  for (int level = KERNEL_SSE2; level <= PixelKernels::GetSupportedLevel(); level++) {
+    int blend_failures = 0;
+    int composite_failures = 0;
+    for (int offset = 0; offset < 64; offset += 4) {
+      for (long length = 0; length < 133; length++) {
+        long count = length < 131 ? length : lengths[length - 131];
+        uint8_t *source = layer.data() + GUARD_BYTES + (offset * 7) % 64;
+        uint32_t alphas[3] = {0, 255, (uint32_t) (1 + rand() % 254)};
+        uint32_t color = (alphas[length % 3] << 24) | (rand() & 0xffffff);
+
+        scalar = initial;
+        simd = initial;
+        PixelKernels::SetLevel(KERNEL_SCALAR);
+        PixelKernels::Blend32(scalar.data() + GUARD_BYTES + offset, color, count);
+        PixelKernels::SetLevel((KernelLevel) level);
+        PixelKernels::Blend32(simd.data() + GUARD_BYTES + offset, color, count);
+        blend_failures += scalar != simd;
+
+        scalar = initial;
+        simd = initial;
+        PixelKernels::SetLevel(KERNEL_SCALAR);
+        PixelKernels::Composite32(scalar.data() + GUARD_BYTES + offset, source, count);
+        PixelKernels::SetLevel((KernelLevel) level);
+        PixelKernels::Composite32(simd.data() + GUARD_BYTES + offset, source, count);
+        composite_failures += scalar != simd;
+      }
+    }
+    const char *name = PixelKernels::GetLevelName((KernelLevel) level);
+    printf("check op=%-11s kernel=%-6s failures=%d\n", "blend32", name, blend_failures);
+    printf("check op=%-11s kernel=%-6s failures=%d\n", "composite32", name, composite_failures);
+    failures += blend_failures + composite_failures;
+  }
+  PixelKernels::SetLevel(PixelKernels::GetSupportedLevel());
+  return failures;
+}
+
+int main(int argc, char *argv[]) {
+  if (argc > 1 && strcmp(argv[1], "--check") == 0) {
+    int failures = Check();
+    printf("check bench_blend: %s\n", failures ? "FAILED" : "ok");
+    return failures ? 1 : 0;
+  }
+
+  Framebuffer fb(new MemoryRenderTarget(SCREEN_WIDTH, SCREEN_HEIGHT));
+  fb.SetDamageMode(DAMAGE_OFF);
+  const double screen_pixels = (double) SCREEN_WIDTH * SCREEN_HEIGHT;
+  const Color opaque(40, 120, 200);
+  const Color translucent(40, 120, 200, 128);
+
+  Polygon diamond;
+  diamond.AddPoint(Point(100, 0));
+  diamond.AddPoint(Point(200, 100));
+  diamond.AddPoint(Point(100, 200));
+  diamond.AddPoint(Point(0, 100));
+
+  /* A HUD: a translucent panel along the bottom, opaque boxes on it, and
+  nothing over the rest of the screen */
+  Layer hud(SCREEN_WIDTH, SCREEN_HEIGHT);
+  hud.GetFramebuffer().FillRect(Point(0, SCREEN_HEIGHT - 200), Point(SCREEN_WIDTH - 1, SCREEN_HEIGHT - 1), Color(0, 0, 0, 160));
+  for (int x = 40; x + 100 < SCREEN_WIDTH; x += 160) {
+    hud.GetFramebuffer().FillRect(Point(x, SCREEN_HEIGHT - 160), Point(x + 100, SCREEN_HEIGHT - 40), COLOR_WHITE);
+  }
+  /* A full screen fade: every pixel translucent */
+  Layer fade(SCREEN_WIDTH, SCREEN_HEIGHT);
+  fade.GetFramebuffer().FillRect(Point(0, 0), Point(SCREEN_WIDTH - 1, SCREEN_HEIGHT - 1), Color(0, 0, 0, 96));
+
+  for (int level = KERNEL_SCALAR; level <= PixelKernels::GetSupportedLevel(); level++) {
+    PixelKernels::SetLevel((KernelLevel) level);
+    const char *name = PixelKernels::GetLevelName((KernelLevel) level);
+
+    double opaque_ns = TimeSmallFills(fb, opaque, 100000);
+    Report(name, "fill_64x64", opaque_ns, 64 * 64, opaque_ns);
+    Report(name, "blend_64x64", TimeSmallFills(fb, translucent, 100000), 64 * 64, opaque_ns);
+
+    opaque_ns = TimeScreenFills(fb, opaque, 100);
+    Report(name, "fill_screen", opaque_ns, screen_pixels, opaque_ns);
+    Report(name, "blend_screen", TimeScreenFills(fb, translucent, 100), screen_pixels, opaque_ns);
+
+    opaque_ns = TimePolygons(fb, diamond, opaque, 20000);
+    Report(name, "polygon", opaque_ns, 200 * 200 / 2, opaque_ns);
+    Report(name, "blend_polygon", TimePolygons(fb, diamond, translucent, 20000), 200 * 200 / 2, opaque_ns);
+
+    int iterations = 100;
+    double start = Now();
+    for (int i = 0; i < iterations; i++) {
+      fb.CompositeLayer(hud);
+    }
+    Report(name, "composite_hud", (Now() - start) / iterations, screen_pixels, TimeScreenFills(fb, opaque, 100));
+
+    start = Now();
+    for (int i = 0; i < iterations; i++) {
+      fb.CompositeLayer(fade);
+    }
+    Report(name, "composite_fade", (Now() - start) / iterations, screen_pixels, TimeScreenFills(fb, opaque, 100));
+  }
+  return 0;
+}
@@ -0,0 +1,168 @@
+#include "../src/graphics/line_clipper.h"
+#include "../src/graphics/pixel_kernels.h"
+#include "../src/graphics/fixed.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <algorithm>
+
+#define SEGMENT_COUNT 4096
+#define CHECK_ROUNDS 20000
+
+/* Benchmark of the batch line clipper at every supported instruction set.
+With --check it compares every instruction set with the scalar path and with
+an exact clipper instead */
+
+/* Current monotonic time in nanoseconds */
+static double Now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/* Liang–Barsky in long double, as close to exact as the end points get */
+static bool ClipExact(int *x0, int *y0, int *x1, int *y1, int xmin, int ymin, int xmax, int ymax) {
+  long double px = *x0;
+  long double py = *y0;
+  long double dx = *x1 - px;
+  long double dy = *y1 - py;
+  long double t0 = 0;
+  long double t1 = 1;
+  if (dx == 0) {
+    if (px < xmin || px > xmax) {
+      return false;
+    }
+  } else {
+    t0 = std::max(t0, std::min((xmin - px) / dx, (xmax - px) / dx));
+    t1 = std::min(t1, std::max((xmin - px) / dx, (xmax - px) / dx));
+  }
+  if (dy == 0) {
+    if (py < ymin || py > ymax) {
+      return false;
+    }
+  } else {
+    t0 = std::max(t0, std::min((ymin - py) / dy, (ymax - py) / dy));
+    t1 = std::min(t1, std::max((ymin - py) / dy, (ymax - py) / dy));
+  }
+  if (t0 > t1) {
+    return false;
+  }
+  *x0 = lrintl(std::min<long double>(std::max<long double>(px + t0 * dx, xmin), xmax));
+  *y0 = lrintl(std::min<long double>(std::max<long double>(py + t0 * dy, ymin), ymax));
+  *x1 = lrintl(std::min<long double>(std::max<long double>(px + t1 * dx, xmin), xmax));
+  *y1 = lrintl(std::min<long double>(std::max<long double>(py + t1 * dy, ymin), ymax));
+  return true;
+}
+
+/* Clip random batches of every length up to 37 (so that every SIMD tail is
+run) of segments in one unit, scale units to a pixel. Every instruction set
+must keep the same segments as the scalar path, at the same end points, and
+those must be within one unit of the exact clipper. Returns the number of
+failures */
+template <class Unit>
+static int CheckUnit(const char *unit, int scale) {
+  Point top_left(200, 100);
+  Point bottom_right(1200, 700);
+  int xmin = top_left.GetX() * scale;
+  int ymin = top_left.GetY() * scale;
+  int xmax = bottom_right.GetX() * scale;
+  int ymax = bottom_right.GetY() * scale;
+  SegmentArrays<Unit> input;
+  SegmentArrays<Unit> scalar;
+  SegmentArrays<Unit> simd;
+  input.Reserve(64);
+  int failures = 0;
+  int worst = 0;
+  for (int round = 0; round < CHECK_ROUNDS; round++) {
+    int count = 1 + round % 37;
+    for (int i = 0; i < count; i++) {
+      input.x0[i] = (rand() % 2000 - 200) * scale + rand() % scale;
+      input.y0[i] = (rand() % 1200 - 200) * scale + rand() % scale;
+      input.x1[i] = (rand() % 2000 - 200) * scale + rand() % scale;
+      input.y1[i] = (rand() % 1200 - 200) * scale + rand() % scale;
+    }
+
+    PixelKernels::SetLevel(KERNEL_SCALAR);
+    scalar = input;
+    int scalar_left = LineClipper::Clip(scalar, count, top_left, bottom_right);
+
+    /* The exact clipper keeps the same segments, in order */
+    int left = 0;
+    for (int i = 0; i < count; i++) {
+      int x0 = input.x0[i];
+      int y0 = input.y0[i];
+      int x1 = input.x1[i];
+      int y1 = input.y1[i];
+      if (ClipExact(&x0, &y0, &x1, &y1, xmin, ymin, xmax, ymax)) {
+        if (left < scalar_left) {
+          int error = std::max(std::max(abs(x0 - scalar.x0[left]), abs(y0 - scalar.y0[left])),
+                               std::max(abs(x1 - scalar.x1[left]), abs(y1 - scalar.y1[left])));
+          worst = std::max(worst, error);
+        }
+        left++;
+      }
+    }
+    if (left != scalar_left) {
+      failures++;
+    }
+
+    for (int level = KERNEL_SCALAR + 1; level <= PixelKernels::GetSupportedLevel(); level++) {
+      PixelKernels::SetLevel((KernelLevel) level);
+      simd = input;
+      int simd_left = LineClipper::Clip(simd, count, top_left, bottom_right);
+      if (simd_left != scalar_left ||
+          memcmp(simd.x0.data(), scalar.x0.data(), simd_left * sizeof(int32_t)) != 0 || memcmp(simd.y0.data(), scalar.y0.data(), simd_left * sizeof(int32_t)) != 0 ||
+          memcmp(simd.x1.data(), scalar.x1.data(), simd_left * sizeof(int32_t)) != 0 || memcmp(simd.y1.data(), scalar.y1.data(), simd_left * sizeof(int32_t)) != 0) {
+        failures++;
+      }
+    }
+  }
+  if (worst > 1) {
+    failures++;
+  }
+  printf("check op=clip unit=%s max_error=%d failures=%d\n", unit, worst, failures);
+  return failures;
+}
+
+int main(int argc, char *argv[]) {
+  if (argc > 1 && strcmp(argv[1], "--check") == 0) {
+    srand(1);
+    int failures = CheckUnit<PixelUnit>("pixel", 1) + CheckUnit<CoordUnit>("coord", COORD_ONE);
+    printf("check bench_clip: %s\n", failures ? "FAILED" : "ok");
+    return failures ? 1 : 0;
+  }
+
+  /* Segments spread over an area four times the clip rectangle, so most
+  cross an edge or miss it */
+  Point top_left(200, 100);
+  Point bottom_right(1200, 700);
+  std::vector<int> coordinates(SEGMENT_COUNT * 4);
+  srand(1);
+  for (unsigned i = 0; i < coordinates.size(); i++) {
+    coordinates[i] = rand() % 2000 - 200;
+  }
+
+  PixelSegments segments;
+  segments.Reserve(SEGMENT_COUNT);
+  for (int level = KERNEL_SCALAR; level <= PixelKernels::GetSupportedLevel(); level++) {
+    PixelKernels::SetLevel((KernelLevel) level);
+    int iterations = 2000;
+    int left = 0;
+    double elapsed = 0;
+    for (int i = 0; i < iterations; i++) {
+      for (int j = 0; j < SEGMENT_COUNT; j++) {
+        segments.x0[j] = coordinates[j * 4];
+        segments.y0[j] = coordinates[j * 4 + 1];
+        segments.x1[j] = coordinates[j * 4 + 2];
+        segments.y1[j] = coordinates[j * 4 + 3];
+      }
+      double start = Now();
+      left = LineClipper::Clip(segments, SEGMENT_COUNT, top_left, bottom_right);
+      elapsed += Now() - start;
+    }
+    printf("kernel=%-6s op=clip segments=%d visible=%d ns_per_segment=%8.2f\n", PixelKernels::GetLevelName((KernelLevel) level), SEGMENT_COUNT, left, elapsed / iterations / SEGMENT_COUNT);
+  }
+  return 0;
+}
@@ -0,0 +1,172 @@
+#include "../src/graphics/framebuffer.h"
+#include "../src/graphics/memory_render_target.h"
+#include "../src/graphics/pixel_kernels.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+
+#define SCREEN_WIDTH 1920
+#define SCREEN_HEIGHT 1080
+
+/* Benchmark of the Clear/FillRect/Display kernels at every supported instruction set.
+With --check it compares every instruction set with the scalar path instead */
+
+/* Current monotonic time in nanoseconds */
+static double Now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/* Print one result line */
+static void Report(const char *kernel, const char *op, double ns_per_call, double pixels_per_call) {
+  printf("kernel=%-6s op=%-10s ns_per_call=%12.0f mpixels_per_s=%10.1f\n", kernel, op, ns_per_call, pixels_per_call * 1e3 / ns_per_call);
+}
+
+/* Bytes around the checked range that a kernel must leave alone */
+#define GUARD_BYTES 64
+
+/* Run kernel on a buffer of random bytes at every instruction set, at dst
+offsets 0 to 63 bytes past a 64 byte boundary and lengths 0 to 130 plus two
+large ones (so that every head, body and tail path is run). Every level must
+leave the whole buffer, guards included, as the scalar path does. Returns the
+number of failures */
+template <class Kernel>
+static int CheckKernel(const char *op, int offset_step, Kernel kernel) {
+  const long lengths[] = {1000, 4099};
+  std::vector<uint8_t> initial(2 * GUARD_BYTES + 4 * 4099 + 64);
+  std::vector<uint8_t> scalar(initial.size());
+  std::vector<uint8_t> simd(initial.size());
+  std::vector<uint8_t> source(initial.size());
+  int failures = 0;
+  for (unsigned i = 0; i < initial.size(); i++) {
+    initial[i] = rand();
+    source[i] = rand();
+  }
+  for (int level = KERNEL_SSE2; level <= PixelKernels::GetSupportedLevel(); level++) {
+    int level_failures = 0;
+    for (int offset = 0; offset < 64; offset += offset_step) {
+      for (long length = 0; length < 133; length++) {
+        long count = length < 131 ? length : lengths[length - 131];
+        scalar = initial;
+        simd = initial;
+        PixelKernels::SetLevel(KERNEL_SCALAR);
+        kernel(scalar.data() + GUARD_BYTES + offset, source.data() + GUARD_BYTES + (offset * 7) % 64, count);
+        PixelKernels::SetLevel((KernelLevel) level);
+        kernel(simd.data() + GUARD_BYTES + offset, source.data() + GUARD_BYTES + (offset * 7) % 64, count);
+        if (scalar != simd) {
+          level_failures++;
+        }
+      }
+    }
+    printf("check op=%-13s kernel=%-6s failures=%d\n", op, PixelKernels::GetLevelName((KernelLevel) level), level_failures);
+    failures += level_failures;
+  }
+  return failures;
+}
+
+/* Draw random fills and present them at every instruction set and pixel depth.
+Every level must leave the same screen as the scalar path. Returns the number
+of failures */
+static int CheckFramebuffer() {
+  const int depths[] = {16, 24, 32};
+  int failures = 0;
+  for (unsigned d = 0; d < sizeof(depths) / sizeof(depths[0]); d++) {
+    std::vector<uint8_t> scalar;
+    for (int level = KERNEL_SCALAR; level <= PixelKernels::GetSupportedLevel(); level++) {
+      PixelKernels::SetLevel((KernelLevel) level);
+      MemoryRenderTarget *target = new MemoryRenderTarget(203, 101, 0, depths[d]);
+      Framebuffer fb(target);
+      srand(2);
+      fb.Clear();
+      for (int i = 0; i < 200; i++) {
+        int x = rand() % 240 - 20;
+        int y = rand() % 120 - 10;
+        fb.FillRect(Point(x, y), Point(x + rand() % 90, y + rand() % 40), Color(rand() % 256, rand() % 256, rand() % 256));
+      }
+      fb.Display();
+      std::vector<uint8_t> screen(target->GetMemory(), target->GetMemory() + target->GetMemorySize());
+      if (level == KERNEL_SCALAR) {
+        scalar = screen;
+      } else {
+        int level_failures = screen != scalar;
+        printf("check op=%-13s kernel=%-6s bits_per_pixel=%d failures=%d\n", "framebuffer", PixelKernels::GetLevelName((KernelLevel) level), depths[d], level_failures);
+        failures += level_failures;
+      }
+    }
+  }
+  return failures;
+}
+
+/* Compare every kernel level with the scalar path, returns the number of failures */
+static int Check() {
+  srand(1);
+  int failures = 0;
+  failures += CheckKernel("fill32", 4, [](uint8_t *dst, const uint8_t *, long count) {
+    PixelKernels::Fill32(dst, 0x12345678, count);
+  });
+  failures += CheckKernel("fill32_stream", 4, [](uint8_t *dst, const uint8_t *, long count) {
+    PixelKernels::Fill32(dst, 0x9abcdef0, count, true);
+  });
+  failures += CheckKernel("stream_copy", 1, [](uint8_t *dst, const uint8_t *src, long count) {
+    PixelKernels::StreamCopy(dst, src, count * 4 - (count & 3));
+  });
+  failures += CheckFramebuffer();
+  PixelKernels::SetLevel(PixelKernels::GetSupportedLevel());
+  return failures;
+}
+
+int main(int argc, char *argv[]) {
+  if (argc > 1 && strcmp(argv[1], "--check") == 0) {
+    int failures = Check();
+    printf("check bench_kernels: %s\n", failures ? "FAILED" : "ok");
+    return failures ? 1 : 0;
+  }
+
+  Framebuffer fb(new MemoryRenderTarget(SCREEN_WIDTH, SCREEN_HEIGHT));
+  fb.SetDamageMode(DAMAGE_OFF);
+  const double screen_pixels = (double) SCREEN_WIDTH * SCREEN_HEIGHT;
+
+  /* Reference: the per-pixel SetPixel loop Clear() used to run */
+  int iterations = 20;
+  double start = Now();
+  for (int i = 0; i < iterations; i++) {
+    for (int y = 0; y < SCREEN_HEIGHT; y++) {
+      for (int x = 0; x < SCREEN_WIDTH; x++) {
+        fb.SetPixel(Point(x, y), COLOR_BLACK);
+      }
+    }
+  }
+  Report("legacy", "clear", (Now() - start) / iterations, screen_pixels);
+
+  for (int level = KERNEL_SCALAR; level <= PixelKernels::GetSupportedLevel(); level++) {
+    PixelKernels::SetLevel((KernelLevel) level);
+    const char *name = PixelKernels::GetLevelName((KernelLevel) level);
+
+    iterations = 200;
+    start = Now();
+    for (int i = 0; i < iterations; i++) {
+      fb.Clear();
+    }
+    Report(name, "clear", (Now() - start) / iterations, screen_pixels);
+
+    iterations = 100000;
+    start = Now();
+    for (int i = 0; i < iterations; i++) {
+      int x = (i * 37) % (SCREEN_WIDTH - 64);
+      int y = (i * 91) % (SCREEN_HEIGHT - 64);
+      fb.FillRect(Point(x, y), Point(x + 63, y + 63), COLOR_GRAY);
+    }
+    Report(name, "fill_64x64", (Now() - start) / iterations, 64 * 64);
+
+    iterations = 200;
+    start = Now();
+    for (int i = 0; i < iterations; i++) {
+      fb.Display();
+    }
+    Report(name, "display", (Now() - start) / iterations, screen_pixels);
+  }
+  return 0;
+}
@@ -0,0 +1,439 @@
+#include "../src/graphics/framebuffer.h"
+#include "../src/graphics/memory_render_target.h"
+#include "../src/graphics/pixel_kernels.h"
+#include "../src/graphics/sprite.h"
+#include "../src/objects/font.h"
+#include "../src/objects/view.h"
+#include <algorithm>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <time.h>
+#include <vector>
+
+#define SCREEN_WIDTH 1920
+#define SCREEN_HEIGHT 1080
+
+/* Timed runs stop after this many nanoseconds or their iteration count */
+#define TIME_LIMIT 200000000.0
+
+/* Microbenchmarks of the public draw calls against an off-screen target, one
+line per case:
+  op=<case> calls=<n> ns_per_call=<ns> mpixels_per_s=<Mpixels/s>
+Pixels per call are the pixels a case touches: the length of a line, the
+area of a fill, or the clip rectangle for sprites, text and views. With
+--check it compares the draw calls at every instruction set with the scalar
+ones, checks that clipped draw calls stay inside their rectangle and checks
+polygon fills against an exact even-odd test instead.
+Usage: bench_raster [--check] [data directory, default "data"] */
+
+/* Current monotonic time in nanoseconds */
+static double Now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/* Run draw up to iterations times (fewer if it takes longer than TIME_LIMIT)
+after one warm up call and print the result */
+template <class Draw>
+static void Run(const char *op, int iterations, double pixels_per_call, Draw draw) {
+  draw(0);
+  int calls = 0;
+  double start = Now();
+  double elapsed = 0;
+  while (calls < iterations && elapsed < TIME_LIMIT) {
+    draw(calls);
+    calls++;
+    elapsed = Now() - start;
+  }
+  double ns_per_call = elapsed / calls;
+  printf("op=%-22s calls=%-8d ns_per_call=%12.0f mpixels_per_s=%10.1f\n", op, calls, ns_per_call, pixels_per_call * 1e3 / ns_per_call);
+}
+
+/* Load a sprite, exit if it is missing */
+static Sprite LoadSprite(const std::string& path) {
+  Sprite sprite(path.c_str());
+  if (sprite.GetPolygonCount() == 0) {
+    fprintf(stderr, "Error: failed to load %s (pass the data directory as the last argument)\n", path.c_str());
+    exit(1);
+  }
+  return sprite;
+}
+
+/* The sprites and font of the map */
+struct MapData {
+  Sprite buildings;
+  Sprite facilities;
+  Sprite poles;
+  Font font;
+
+  MapData(const std::string& data)
+      : buildings(LoadSprite(data + "/buildings.txt")), facilities(LoadSprite(data + "/facilities.txt")),
+        poles(LoadSprite(data + "/poles.txt")), font((data + "/font.txt").c_str()) {}
+};
+
+/* A random point up to margin pixels outside a width x height screen, with
+a fractional part */
+static Point RandomPoint(int width, int height, int margin) {
+  return Point::FromCoord(rand() % ((width + 2 * margin) * COORD_ONE) - margin * COORD_ONE,
+                          rand() % ((height + 2 * margin) * COORD_ONE) - margin * COORD_ONE);
+}
+
+/* A random opaque color other than black */
+static Color RandomColor() {
+  return Color(1 + rand() % 255, rand() % 256, rand() % 256);
+}
+
+/* Draw random polygons, sprites, lines, text and views, all clipped to the
+rectangle from top_left to bottom_right */
+static void DrawClipped(Framebuffer& fb, MapData& map, const Point& top_left, const Point& bottom_right) {
+  int width = fb.GetWidth();
+  int height = fb.GetHeight();
+  for (int i = 0; i < 10; i++) {
+    Polygon polygon;
+    int points = 3 + rand() % 6;
+    for (int j = 0; j < points; j++) {
+      polygon.AddPoint(RandomPoint(width, height, 40));
+    }
+    fb.DrawRasteredPolygon(polygon, RandomColor(), RandomColor(), top_left, bottom_right, rand() % 20 - 10, rand() % 20 - 10);
+    Point pivot = RandomPoint(width, height, 0);
+    fb.DrawRasteredPolygon(polygon, Transform2D::Rotation(pivot, rand() % 3600 / 10.0), RandomColor(), RandomColor(), top_left, bottom_right);
+  }
+
+  Point pivot = RandomPoint(width, height, 0);
+  fb.DrawClippedSprite(map.buildings, top_left, bottom_right, rand() % 100 - 50, rand() % 100 - 50);
+  fb.DrawClippedSprite(map.facilities, Transform2D::Rotation(pivot, rand() % 360).Then(Transform2D::Scaling(pivot, 0.25 + rand() % 100 / 50.0)), top_left, bottom_right);
+
+  std::vector<Point> starts;
+  std::vector<Point> ends;
+  for (int i = 0; i < 37; i++) {
+    starts.push_back(RandomPoint(width, height, 100));
+    ends.push_back(RandomPoint(width, height, 100));
+  }
+  fb.ClipLine(starts[0], ends[0], top_left, bottom_right, RandomColor());
+  fb.ClipLines(starts.data(), ends.data(), starts.size(), top_left, bottom_right, RandomColor());
+
+  Font::RenderText("THE QUICK BROWN FOX", map.font, fb, RandomPoint(width, height, 50), RandomColor(), RandomColor(), RandomColor(), 1 + rand() % 3, top_left, bottom_right);
+
+  View view(top_left, bottom_right, RandomColor());
+  view.AddSource(&map.buildings);
+  view.AddSource(&map.facilities);
+  view.AddSource(&map.poles);
+  int source_size = 50 + rand() % 550;
+  Point source_top_left(rand() % 300, rand() % 300);
+  view.SetSourcePosition(source_top_left, Point::Translate(source_top_left, Point(source_size, source_size)));
+  view.Render(fb);
+  view.SetTileCaching(true);
+  view.Render(fb);
+}
+
+/* A random clip rectangle, inside the screen or partly outside it */
+static void RandomClip(int width, int height, Point *top_left, Point *bottom_right) {
+  *top_left = Point(rand() % width - 20, rand() % height - 20);
+  *bottom_right = Point(top_left->GetX() + rand() % width, top_left->GetY() + rand() % height);
+}
+
+/* Render the same frames of unclipped and clipped draw calls at every
+instruction set and bit depth and compare them with the scalar frames.
+Returns the number of failures */
+static int CheckLevels(MapData& map) {
+  const int depths[] = {16, 24, 32};
+  const int width = 479;
+  const int height = 317;
+  int failures = 0;
+  for (unsigned d = 0; d < sizeof(depths) / sizeof(depths[0]); d++) {
+    std::vector<uint8_t> scalar;
+    for (int level = KERNEL_SCALAR; level <= PixelKernels::GetSupportedLevel(); level++) {
+      PixelKernels::SetLevel((KernelLevel) level);
+      MemoryRenderTarget *target = new MemoryRenderTarget(width, height, 0, depths[d]);
+      Framebuffer fb(target);
+      srand(2);
+      fb.Clear();
+      for (int frame = 0; frame < 4; frame++) {
+        for (int i = 0; i < 8; i++) {
+          fb.DrawLine(RandomPoint(width, height, 100), RandomPoint(width, height, 100), RandomColor());
+          fb.DrawDottedLine(RandomPoint(width, height, 100), RandomPoint(width, height, 100), RandomColor(), 1 + rand() % 6);
+          fb.DrawCircle(RandomPoint(width, height, 50), rand() % 200, RandomColor());
+          fb.DrawFilledCircle(RandomPoint(width, height, 50), rand() % 200, RandomColor(), RandomColor());
+        }
+        Point top_left;
+        Point bottom_right;
+        RandomClip(width, height, &top_left, &bottom_right);
+        DrawClipped(fb, map, top_left, bottom_right);
+        fb.Display();
+      }
+      std::vector<uint8_t> screen(target->GetMemory(), target->GetMemory() + target->GetMemorySize());
+      if (level == KERNEL_SCALAR) {
+        scalar = screen;
+      } else {
+        int level_failures = screen != scalar;
+        printf("check op=%-12s kernel=%-6s bits_per_pixel=%d failures=%d\n", "draw", PixelKernels::GetLevelName((KernelLevel) level), depths[d], level_failures);
+        failures += level_failures;
+      }
+    }
+  }
+  PixelKernels::SetLevel(PixelKernels::GetSupportedLevel());
+  return failures;
+}
+
+/* Draw clipped calls into random rectangles and check that no pixel outside
+the rectangle changes. Returns the number of failures */
+static int CheckClipping(MapData& map) {
+  const int width = 479;
+  const int height = 317;
+  MemoryRenderTarget *target = new MemoryRenderTarget(width, height);
+  Framebuffer fb(target);
+  srand(3);
+  int failures = 0;
+  for (int round = 0; round < 50; round++) {
+    fb.Clear();
+    fb.Display();
+    const uint32_t *screen = (const uint32_t *) target->GetMemory();
+    std::vector<uint32_t> before(screen, screen + width * height);
+    Point top_left;
+    Point bottom_right;
+    RandomClip(width, height, &top_left, &bottom_right);
+    DrawClipped(fb, map, top_left, bottom_right);
+    fb.Display();
+    for (int y = 0; y < height; y++) {
+      for (int x = 0; x < width; x++) {
+        bool is_inside = x >= top_left.GetX() && x <= bottom_right.GetX() && y >= top_left.GetY() && y <= bottom_right.GetY();
+        failures += !is_inside && screen[y * width + x] != before[y * width + x];
+      }
+    }
+  }
+  printf("check op=%-12s kernel=%-6s failures=%d\n", "clip", PixelKernels::GetLevelName(PixelKernels::GetLevel()), failures);
+  return failures;
+}
+
+/* Crossings closer to a pixel centre than this many pixels are left out of
+the fill check, as the 16.16 edge steps may round them to either side */
+#define CROSSING_TOLERANCE (1.0 / 32)
+
+/* Fill random polygons, some moved or rotated and scaled, with a color used
+nowhere else and compare every pixel with an exact even-odd test of its
+centre: pixels strictly inside must be fill or outline, and fill pixels
+must be inside. Returns the number of failures */
+static int CheckPolygonFill() {
+  const int width = 211;
+  const int height = 157;
+  MemoryRenderTarget *target = new MemoryRenderTarget(width, height);
+  Framebuffer fb(target);
+  const Color fill(0x10, 0x20, 0x30);
+  const Color border(0xf0, 0xe0, 0xd0);
+  const uint32_t fill_pixel = fb.PackColor(fill);
+  const uint32_t border_pixel = fb.PackColor(border);
+  const uint32_t *screen = (const uint32_t *) target->GetMemory();
+  Point top_left(0, 0);
+  Point bottom_right(width - 1, height - 1);
+  srand(4);
+  int failures = 0;
+  std::vector<double> xs;
+  std::vector<double> ys;
+  std::vector<double> crossings;
+  for (int round = 0; round < 400; round++) {
+    Polygon polygon;
+    int points = 3 + rand() % 8;
+    for (int i = 0; i < points; i++) {
+      polygon.AddPoint(RandomPoint(width, height, 60));
+    }
+
+    /* The corners the fill sees, in pixels */
+    fb.Clear();
+    xs.clear();
+    ys.clear();
+    if (round % 2 == 0) {
+      int xoffset = rand() % 40 - 20;
+      int yoffset = rand() % 40 - 20;
+      fb.DrawRasteredPolygon(polygon, border, fill, top_left, bottom_right, xoffset, yoffset);
+      for (int i = 0; i < points; i++) {
+        xs.push_back((double) polygon.GetXs()[i] / COORD_ONE + xoffset);
+        ys.push_back((double) polygon.GetYs()[i] / COORD_ONE + yoffset);
+      }
+    } else {
+      Point pivot = RandomPoint(width, height, 0);
+      Transform2D transform = Transform2D::Rotation(pivot, rand() % 3600 / 10.0).Then(Transform2D::Scaling(pivot, 0.5 + rand() % 100 / 100.0));
+      fb.DrawRasteredPolygon(polygon, transform, border, fill, top_left, bottom_right);
+      for (int i = 0; i < points; i++) {
+        Point corner = transform.Apply(Point::FromCoord(polygon.GetXs()[i], polygon.GetYs()[i]));
+        xs.push_back((double) corner.GetCoordX() / COORD_ONE);
+        ys.push_back((double) corner.GetCoordY() / COORD_ONE);
+      }
+    }
+    fb.Display();
+
+    for (int y = 0; y < height; y++) {
+      /* Scanline y crosses the edges from y_a to y_b with y_a <= y < y_b */
+      crossings.clear();
+      for (int i = 0; i < points; i++) {
+        int j = i == 0 ? points - 1 : i - 1;
+        double y_top = std::min(ys[i], ys[j]);
+        double y_bottom = std::max(ys[i], ys[j]);
+        if (y_top <= y && y < y_bottom) {
+          crossings.push_back(xs[j] + (y - ys[j]) * (xs[i] - xs[j]) / (ys[i] - ys[j]));
+        }
+      }
+      std::sort(crossings.begin(), crossings.end());
+      unsigned left = 0;
+      for (int x = 0; x < width; x++) {
+        while (left < crossings.size() && crossings[left] < x) {
+          left++;
+        }
+        bool is_near = (left > 0 && x - crossings[left - 1] < CROSSING_TOLERANCE) ||
+                       (left < crossings.size() && crossings[left] - x < CROSSING_TOLERANCE);
+        if (is_near) {
+          continue;
+        }
+        bool is_inside = left % 2 == 1;
+        uint32_t pixel = screen[y * width + x];
+        failures += is_inside ? pixel != fill_pixel && pixel != border_pixel : pixel == fill_pixel;
+      }
+    }
+  }
+  printf("check op=%-12s kernel=%-6s failures=%d\n", "polygon_fill", PixelKernels::GetLevelName(PixelKernels::GetLevel()), failures);
+  return failures;
+}
+
+int main(int argc, char *argv[]) {
+  bool is_check = argc > 1 && strcmp(argv[1], "--check") == 0;
+  std::string data = argc > 1 + is_check ? argv[1 + is_check] : "data";
+  if (is_check) {
+    MapData map(data);
+    int failures = CheckLevels(map) + CheckClipping(map) + CheckPolygonFill();
+    printf("check bench_raster: %s\n", failures ? "FAILED" : "ok");
+    return failures ? 1 : 0;
+  }
+
+  Sprite buildings = LoadSprite(data + "/buildings.txt");
+  Sprite facilities = LoadSprite(data + "/facilities.txt");
+  Sprite poles = LoadSprite(data + "/poles.txt");
+  Font font((data + "/font.txt").c_str());
+
+  Framebuffer fb(new MemoryRenderTarget(SCREEN_WIDTH, SCREEN_HEIGHT));
+  fb.SetDamageMode(DAMAGE_OFF);
+  const double screen_pixels = (double) SCREEN_WIDTH * SCREEN_HEIGHT;
+  Point screen_top_left(0, 0);
+  Point screen_bottom_right(SCREEN_WIDTH - 1, SCREEN_HEIGHT - 1);
+  Point center(SCREEN_WIDTH / 2, SCREEN_HEIGHT / 2);
+
+  /* Lines from the center, one per octant, 400 pixels along their major axis */
+  const int octant_dx[8] = {400, 200, -200, -400, -400, -200, 200, 400};
+  const int octant_dy[8] = {200, 400, 400, 200, -200, -400, -400, -200};
+  for (int octant = 0; octant < 8; octant++) {
+    char op[32];
+    snprintf(op, sizeof(op), "line_octant%d", octant);
+    Point end = Point::Translate(center, Point(octant_dx[octant], octant_dy[octant]));
+    Run(op, 100000, 401, [&](int) { fb.DrawLine(center, end, COLOR_WHITE); });
+  }
+  Run("dotted_line", 100000, 401, [&](int) {
+    fb.DrawDottedLine(center, Point::Translate(center, Point(400, 150)), COLOR_WHITE, 4);
+  });
+
+  Run("circle_r200", 20000, 2 * M_PI * 200, [&](int) { fb.DrawCircle(center, 200, COLOR_WHITE); });
+  Run("filled_circle_r200", 5000, M_PI * 200 * 200, [&](int) {
+    fb.DrawFilledCircle(center, 200, COLOR_WHITE, COLOR_BLUE);
+  });
+
+  /* Polygons: a small triangle, a quad nearly as big as the screen, and a
+  concave comb whose scanlines cross many edges */
+  Polygon small;
+  small.AddPoint(Point(0, 0));
+  small.AddPoint(Point(12, 3));
+  small.AddPoint(Point(4, 12));
+  Run("polygon_small", 200000, 12 * 12 / 2, [&](int i) {
+    fb.DrawRasteredPolygon(small, COLOR_WHITE, COLOR_RED, screen_top_left, screen_bottom_right, (i * 37) % (SCREEN_WIDTH - 16), (i * 91) % (SCREEN_HEIGHT - 16));
+  });
+
+  Polygon huge;
+  huge.AddPoint(Point(-100, 20));
+  huge.AddPoint(Point(SCREEN_WIDTH + 100, -50));
+  huge.AddPoint(Point(SCREEN_WIDTH - 20, SCREEN_HEIGHT + 80));
+  huge.AddPoint(Point(30, SCREEN_HEIGHT - 10));
+  Run("polygon_huge", 500, screen_pixels, [&](int) {
+    fb.DrawRasteredPolygon(huge, COLOR_WHITE, COLOR_GREEN, screen_top_left, screen_bottom_right);
+  });
+
+  Polygon comb;
+  const int teeth = 40;
+  for (int i = 0; i < teeth; i++) {
+    comb.AddPoint(Point(100 + i * 40, 900));
+    comb.AddPoint(Point(120 + i * 40, 100));
+    comb.AddPoint(Point(140 + i * 40, 900));
+  }
+  comb.AddPoint(Point(100 + teeth * 40, 1000));
+  comb.AddPoint(Point(100, 1000));
+  Run("polygon_concave", 2000, teeth * 40 * 400 + teeth * 40 * 100, [&](int) {
+    fb.DrawRasteredPolygon(comb, COLOR_WHITE, COLOR_YELLOW, screen_top_left, screen_bottom_right);
+  });
+
+  /* Sprites of the map at their own scale, clipped to a 600x600 window */
+  Point map_bottom_right(599, 599);
+  Run("sprite_buildings", 2000, 600 * 600, [&](int) {
+    fb.DrawClippedSprite(buildings, screen_top_left, map_bottom_right);
+  });
+  Run("sprite_facilities", 2000, 600 * 600, [&](int) {
+    fb.DrawClippedSprite(facilities, screen_top_left, map_bottom_right);
+  });
+
+  Point text_top_left(100, 100);
+  Point text_bottom_right(1800, 300);
+  Run("text", 5000, 1700 * 200, [&](int) {
+    Font::RenderText("THE QUICK BROWN FOX", font, fb, text_top_left, COLOR_WHITE, COLOR_RED, COLOR_BLACK, 3, text_top_left, text_bottom_right);
+  });
+
+  /* The game screen view looking at the whole map down to a 50x50 corner of it */
+  Point view_top_left(360, 140);
+  Point view_bottom_right(1260, 940);
+  View view(view_top_left, view_bottom_right, COLOR_WHITE);
+  view.AddSource(&buildings);
+  view.AddSource(&facilities);
+  view.AddSource(&poles);
+  const int view_sizes[4] = {600, 300, 100, 50};
+  for (int i = 0; i < 4; i++) {
+    char op[32];
+    snprintf(op, sizeof(op), "view_source%d", view_sizes[i]);
+    view.SetSourcePosition(Point(250, 250), Point(250 + view_sizes[i], 250 + view_sizes[i]));
+    Run(op, 1000, 900 * 800, [&](int) { view.Render(fb); });
+  }
+
+  /* The mini map: the whole map shrunk to 300x300, drawn at a coarser level of detail */
+  View mini_map(Point(960, 540), Point(1260, 840), COLOR_WHITE);
+  mini_map.AddSource(&buildings);
+  mini_map.AddSource(&facilities);
+  mini_map.AddSource(&poles);
+  mini_map.SetSourcePosition(Point(0, 0), Point(600, 600));
+  Run("view_minimap", 1000, 300 * 300, [&](int) { mini_map.Render(fb); });
+  mini_map.SetTileCaching(true);
+  Run("view_minimap_tiles", 1000, 300 * 300, [&](int) { mini_map.Render(fb); });
+
+  /* The same 100x100 window into the buildings repeated over a map 8 times
+  as wide and high, which should cost about as much as the small map */
+  Sprite campus;
+  for (int tile = 0; tile < 64; tile++) {
+    Point tile_offset((tile % 8) * 600, (tile / 8) * 600);
+    for (int i = 0; i < buildings.GetPolygonCount(); i++) {
+      const SpritePolygon& entry = buildings.GetPolygon(i);
+      Polygon polygon;
+      for (int j = entry.first_point; j < entry.first_point + entry.point_count; j++) {
+        polygon.AddPoint(Point::FromCoord(buildings.GetXs()[j], buildings.GetYs()[j]));
+      }
+      polygon.Translate(tile_offset);
+      campus.AddPolygon(polygon, entry.fill_color, entry.border_color);
+    }
+  }
+  View small_map_view(view_top_left, view_bottom_right, COLOR_WHITE);
+  View campus_view(view_top_left, view_bottom_right, COLOR_WHITE);
+  small_map_view.AddSource(&buildings);
+  campus_view.AddSource(&campus);
+  small_map_view.SetSourcePosition(Point(250, 250), Point(350, 350));
+  campus_view.SetSourcePosition(Point(250, 250), Point(350, 350));
+  Run("view_map1x1", 1000, 900 * 800, [&](int) { small_map_view.Render(fb); });
+  Run("view_map8x8", 1000, 900 * 800, [&](int) { campus_view.Render(fb); });
+
+  Run("clear", 500, screen_pixels, [&](int) { fb.Clear(); });
+  Run("display", 500, screen_pixels, [&](int) { fb.Display(); });
+  return 0;
+}
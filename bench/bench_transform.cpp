@@ -0,0 +1,138 @@
+#include "../src/graphics/transform.h"
+#include "../src/graphics/sprite.h"
+#include "../src/graphics/polygon.h"
+#include "../src/graphics/pixel_kernels.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <string>
+#include <vector>
+
+#define POINT_COUNT 16384
+
+/* Benchmark of the batched point transforms at every supported instruction
+set, on coordinate arrays and on the map sprite. With --check it compares
+the batched transforms and the trig table with their single point and
+libm counterparts instead.
+Usage: bench_transform [--check | data directory, default "data"] */
+
+/* Current monotonic time in nanoseconds */
+static double Now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/* Coordinates around the checked range that a transform must leave alone */
+#define GUARD_COORDS 16
+
+/* Transform random points by random rotations, scalings and moves at every
+instruction set, at array offsets 0 to 7 and lengths 0 to 40 plus a large
+one. Every point must match Transform2D::Apply on the single point, and
+nothing past the arrays may change. Returns the number of failures */
+static int CheckApply() {
+  const int count_max = 1000;
+  CoordArray xs(count_max + 2 * GUARD_COORDS), ys(count_max + 2 * GUARD_COORDS);
+  CoordArray result_xs(xs.size()), result_ys(xs.size());
+  int failures = 0;
+  for (int level = KERNEL_SCALAR; level <= PixelKernels::GetSupportedLevel(); level++) {
+    PixelKernels::SetLevel((KernelLevel) level);
+    int level_failures = 0;
+    for (int round = 0; round < 2000; round++) {
+      Point pivot(rand() % 4000 - 2000, rand() % 4000 - 2000);
+      Transform2D transform = Transform2D::Rotation(pivot, (rand() % 7200) / 10.0 - 360)
+                                .Then(Transform2D::Scaling(pivot, (rand() % 4000) / 1000.0, (rand() % 4000) / 1000.0))
+                                .Then(Transform2D::Translation(Point(rand() % 2000 - 1000, rand() % 2000 - 1000)));
+      int offset = round % 8;
+      int count = round % 42 == 41 ? count_max - offset : round % 42;
+      for (unsigned i = 0; i < xs.size(); i++) {
+        xs[i] = rand() % (8000 * COORD_ONE) - 4000 * COORD_ONE;
+        ys[i] = rand() % (8000 * COORD_ONE) - 4000 * COORD_ONE;
+        result_xs[i] = -1;
+        result_ys[i] = -1;
+      }
+      transform.Apply(xs.data() + GUARD_COORDS + offset, ys.data() + GUARD_COORDS + offset, count,
+                      result_xs.data() + GUARD_COORDS + offset, result_ys.data() + GUARD_COORDS + offset);
+      for (int i = 0; i < (int) xs.size(); i++) {
+        int j = i - GUARD_COORDS - offset;
+        if (j >= 0 && j < count) {
+          Point expected = transform.Apply(Point::FromCoord(xs[i], ys[i]));
+          level_failures += result_xs[i] != expected.GetCoordX() || result_ys[i] != expected.GetCoordY();
+        } else {
+          level_failures += result_xs[i] != -1 || result_ys[i] != -1;
+        }
+      }
+    }
+    printf("check op=%-9s kernel=%-6s failures=%d\n", "transform", PixelKernels::GetLevelName((KernelLevel) level), level_failures);
+    failures += level_failures;
+  }
+  PixelKernels::SetLevel(PixelKernels::GetSupportedLevel());
+  return failures;
+}
+
+/* The tabled sines and cosines of every angle step in a turn must be libm's,
+rounded, and whole turns either way must land on the same entries */
+static int CheckSinCos() {
+  int failures = 0;
+  for (int step = 0; step < ANGLE_STEPS; step++) {
+    double theta = step / (double) ANGLE_STEPS_PER_DEGREE;
+    Factor sin_theta;
+    Factor cos_theta;
+    Transform2D::SinCos(theta, &sin_theta, &cos_theta);
+    failures += sin_theta != FactorFromDouble(sin(theta * PI / 180)) || cos_theta != FactorFromDouble(cos(theta * PI / 180));
+    for (int turns = -2; turns <= 2; turns += 4) {
+      Factor turned_sin;
+      Factor turned_cos;
+      Transform2D::SinCos(theta + turns * 360, &turned_sin, &turned_cos);
+      failures += turned_sin != sin_theta || turned_cos != cos_theta;
+    }
+  }
+  printf("check op=%-9s kernel=%-6s failures=%d\n", "sin_cos", "table", failures);
+  return failures;
+}
+
+int main(int argc, char *argv[]) {
+  if (argc > 1 && strcmp(argv[1], "--check") == 0) {
+    srand(1);
+    int failures = CheckApply() + CheckSinCos();
+    printf("check bench_transform: %s\n", failures ? "FAILED" : "ok");
+    return failures ? 1 : 0;
+  }
+
+  std::string data_path = argc > 1 ? argv[1] : "data";
+  Sprite buildings((data_path + "/buildings.txt").c_str());
+  int sprite_points = buildings.GetNumOfPoints();
+
+  CoordArray xs(POINT_COUNT), ys(POINT_COUNT);
+  CoordArray result_xs(POINT_COUNT), result_ys(POINT_COUNT);
+  srand(1);
+  for (int i = 0; i < POINT_COUNT; i++) {
+    xs[i] = rand() % (2000 * COORD_ONE);
+    ys[i] = rand() % (2000 * COORD_ONE);
+  }
+  Point pivot(683, 450);
+  Transform2D transform = Transform2D::Rotation(pivot, 30).Then(Transform2D::Scaling(pivot, 1.5, 0.75));
+
+  for (int level = KERNEL_SCALAR; level <= PixelKernels::GetSupportedLevel(); level++) {
+    PixelKernels::SetLevel((KernelLevel) level);
+    const char *name = PixelKernels::GetLevelName((KernelLevel) level);
+
+    int iterations = 2000;
+    double start = Now();
+    for (int i = 0; i < iterations; i++) {
+      transform.Apply(xs.data(), ys.data(), POINT_COUNT, result_xs.data(), result_ys.data());
+    }
+    printf("kernel=%-6s op=transform points=%d ns_per_point=%8.3f\n", name, POINT_COUNT, (Now() - start) / iterations / POINT_COUNT);
+
+    /* Rotate back and forth so the sprite stays in place */
+    iterations = 500;
+    start = Now();
+    for (int i = 0; i < iterations; i++) {
+      buildings.Rotate(pivot, (i & 1) ? -90 : 90);
+    }
+    printf("kernel=%-6s op=sprite_rotate points=%d ns_per_point=%8.3f\n", name, sprite_points, (Now() - start) / iterations / sprite_points);
+  }
+  return 0;
+}
@@ -0,0 +1,49 @@
+#ifndef ALIGNED_ALLOCATOR_H
+#define ALIGNED_ALLOCATOR_H
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/* Allocator for std::vector storage that starts on an Alignment byte boundary,
+so that SIMD kernels can walk it a whole register at a time */
+template <class T, size_t Alignment>
+class AlignedAllocator {
+public:
+  typedef T value_type;
+
+  template <class U>
+  struct rebind {
+    typedef AlignedAllocator<U, Alignment> other;
+  };
+
+  /* Constructor */
+  AlignedAllocator() {}
+  template <class U>
+  AlignedAllocator(const AlignedAllocator<U, Alignment>&) {}
+
+  T *allocate(size_t count) {
+    void *memory;
+    if (posix_memalign(&memory, Alignment, count * sizeof(T)) != 0) {
+      perror("Error: failed to allocate aligned storage");
+      exit(6);
+    }
+    return (T*) memory;
+  }
+
+  void deallocate(T *memory, size_t) {
+    free(memory);
+  }
+};
+
+template <class T, class U, size_t Alignment>
+bool operator==(const AlignedAllocator<T, Alignment>&, const AlignedAllocator<U, Alignment>&) {
+  return true;
+}
+
+template <class T, class U, size_t Alignment>
+bool operator!=(const AlignedAllocator<T, Alignment>&, const AlignedAllocator<U, Alignment>&) {
+  return false;
+}
+
+#endif
@@ -0,0 +1,84 @@
+#include "bounding_box.h"
+#include <algorithm>
+
+/* Constructor (empty box) */
+BoundingBox::BoundingBox() : x_min_(COORD_ONE), y_min_(COORD_ONE), x_max_(0), y_max_(0) {}
+
+/* Returns the box of the count points (xs[i], ys[i]) */
+BoundingBox BoundingBox::Of(const Coord *xs, const Coord *ys, int count) {
+  BoundingBox box;
+  if (count == 0) {
+    return box;
+  }
+
+  /* One pass per axis over contiguous coordinates, so that the compiler
+  vectorizes it */
+  box.x_min_ = box.x_max_ = xs[0];
+  box.y_min_ = box.y_max_ = ys[0];
+  for (int i = 1; i < count; i++) {
+    box.x_min_ = std::min(box.x_min_, xs[i]);
+    box.x_max_ = std::max(box.x_max_, xs[i]);
+  }
+  for (int i = 1; i < count; i++) {
+    box.y_min_ = std::min(box.y_min_, ys[i]);
+    box.y_max_ = std::max(box.y_max_, ys[i]);
+  }
+  return box;
+}
+
+/* Returns a box holding every point of this box moved by transform */
+BoundingBox BoundingBox::Transform(const Transform2D& transform) const {
+  if (IsEmpty()) {
+    return *this;
+  }
+
+  /* An affine map keeps points inside the image of the corners */
+  Coord xs[4] = {x_min_, x_max_, x_min_, x_max_};
+  Coord ys[4] = {y_min_, y_min_, y_max_, y_max_};
+  transform.Apply(xs, ys, 4, xs, ys);
+  return Of(xs, ys, 4);
+}
+
+/* Grow this box to hold box too */
+void BoundingBox::Add(const BoundingBox& box) {
+  if (box.IsEmpty()) {
+    return;
+  }
+  if (IsEmpty()) {
+    *this = box;
+    return;
+  }
+  x_min_ = std::min(x_min_, box.x_min_);
+  y_min_ = std::min(y_min_, box.y_min_);
+  x_max_ = std::max(x_max_, box.x_max_);
+  y_max_ = std::max(y_max_, box.y_max_);
+}
+
+/* Checks whether the box holds no point */
+bool BoundingBox::IsEmpty() const {
+  return x_min_ > x_max_;
+}
+
+/* Checks whether no pixel of the box is inside the rectangle */
+bool BoundingBox::IsOutside(const Point& top_left, const Point& bottom_right, int xoffset, int yoffset) const {
+  return IsEmpty() ||
+         GetXMax() + xoffset < top_left.GetX() || GetXMin() + xoffset > bottom_right.GetX() ||
+         GetYMax() + yoffset < top_left.GetY() || GetYMin() + yoffset > bottom_right.GetY();
+}
+
+/* Getter */
+int BoundingBox::GetXMin() const {
+  return CoordToInt(x_min_);
+}
+
+int BoundingBox::GetXMax() const {
+  return CoordToInt(x_max_);
+}
+
+int BoundingBox::GetYMin() const {
+  return CoordToInt(y_min_);
+}
+
+int BoundingBox::GetYMax() const {
+  return CoordToInt(y_max_);
+}
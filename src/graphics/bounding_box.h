@@ -0,0 +1,46 @@
+#ifndef BOUNDING_BOX_H
+#define BOUNDING_BOX_H
+
+#include "fixed.h"
+#include "point.h"
+#include "transform.h"
+
+/* Smallest axis aligned rectangle holding a set of points (24.8 fixed point),
+used to skip geometry that falls outside a clip rectangle before any per row
+work. A box of no points is empty */
+class BoundingBox {
+public:
+  /* Constructor (empty box) */
+  BoundingBox();
+
+  /* Returns the box of the count points (xs[i], ys[i]) */
+  static BoundingBox Of(const Coord *xs, const Coord *ys, int count);
+
+  /* Returns a box holding every point of this box moved by transform. It
+  holds the transformed points too, as they are rounded the same way */
+  BoundingBox Transform(const Transform2D& transform) const;
+
+  /* Grow this box to hold box too */
+  void Add(const BoundingBox& box);
+
+  /* Checks whether the box holds no point */
+  bool IsEmpty() const;
+
+  /* Checks whether no pixel of the box, moved by (xoffset, yoffset), is inside
+  the rectangle from top_left to bottom_right */
+  bool IsOutside(const Point& top_left, const Point& bottom_right, int xoffset = 0, int yoffset = 0) const;
+
+  /* Getter (nearest whole pixel, as the rasterizer rounds the points) */
+  int GetXMin() const;
+  int GetXMax() const;
+  int GetYMin() const;
+  int GetYMax() const;
+
+private:
+  Coord x_min_;
+  Coord y_min_;
+  Coord x_max_;
+  Coord y_max_;
+};
+
+#endif
@@ -1,46 +1,57 @@
 #ifndef COLOR_H
 #define COLOR_H
 
-#define COLOR_BLACK (Color(0, 0, 0))
-#define COLOR_RED (Color(255, 0, 0))
-#define COLOR_ORANGE (Color(255, 127, 0))
-#define COLOR_YELLOW (Color(255, 255, 0))
-#define COLOR_GREEN (Color(0, 255, 0))
-#define COLOR_BLUE (Color(0, 0, 255))
-#define COLOR_INDIGO (Color(75, 0, 130))
-#define COLOR_VIOLET (Color(148, 0, 211))
-#define COLOR_WHITE (Color(255, 255, 255))
-#define COLOR_CYAN (Color(0, 255, 255))
-#define COLOR_SILVER (Color(192, 192, 192))
-#define COLOR_BRONZE (Color(205, 127, 50))
-#define COLOR_DEEP_SKY_BLUE (Color(0, 191, 255))
-#define COLOR_DARK_GREEN (Color(0, 100, 0))
-#define COLOR_GRAY (Color(103, 110, 106))
+#include <stdint.h>
 
 class Color {
 public:
-  /* Constructor */
-  Color() {}
-  Color(unsigned char r, unsigned g, unsigned b) : r_(r), g_(g), b_(b) {}
+  /* Constructor (opaque black unless given) */
+  constexpr Color() : pixel_(0xff000000) {}
+  constexpr Color(unsigned char r, unsigned char g, unsigned char b, unsigned char a = 255) : pixel_(((uint32_t) a << 24) | (r << 16) | (g << 8) | b) {}
+
+  /* Returns the opaque color of a device pixel (XRGB8888, the padding byte is ignored) */
+  static constexpr Color FromPixel(uint32_t pixel) {
+    return Color((pixel >> 16) & 0xff, (pixel >> 8) & 0xff, pixel & 0xff);
+  }
 
   /* Getter */
-  unsigned char GetR() const { return r_; }
-  unsigned char GetG() const { return g_; }
-  unsigned char GetB() const { return b_; }
+  constexpr unsigned char GetR() const { return (pixel_ >> 16) & 0xff; }
+  constexpr unsigned char GetG() const { return (pixel_ >> 8) & 0xff; }
+  constexpr unsigned char GetB() const { return pixel_ & 0xff; }
+  constexpr unsigned char GetA() const { return pixel_ >> 24; } /* 255 is opaque, 0 is invisible */
+
+  /* Device native pixel value with the alpha in the padding byte (ARGB8888,
+  stored as B, G, R, A in memory) */
+  constexpr uint32_t GetPixel() const { return pixel_; }
 
   /* Setter */
-  void SetR(unsigned char r) { r_ = r; }
-  void SetG(unsigned char g) { g_ = g; }
-  void SetB(unsigned char b) { b_ = b; }
+  void SetR(unsigned char r) { pixel_ = (pixel_ & 0xff00ffff) | (r << 16); }
+  void SetG(unsigned char g) { pixel_ = (pixel_ & 0xffff00ff) | (g << 8); }
+  void SetB(unsigned char b) { pixel_ = (pixel_ & 0xffffff00) | b; }
+  void SetA(unsigned char a) { pixel_ = (pixel_ & 0x00ffffff) | ((uint32_t) a << 24); }
 
   static bool IsColorSame(const Color& color1, const Color& color2) {
-    return (color1.r_ == color2.r_ && color1.g_ == color2.g_ && color1.b_ == color2.b_);
+    return color1.pixel_ == color2.pixel_;
   }
 
 private:
-  unsigned char r_;
-  unsigned char g_;
-  unsigned char b_;
+  uint32_t pixel_;
 };
 
+constexpr Color COLOR_BLACK(0, 0, 0);
+constexpr Color COLOR_RED(255, 0, 0);
+constexpr Color COLOR_ORANGE(255, 127, 0);
+constexpr Color COLOR_YELLOW(255, 255, 0);
+constexpr Color COLOR_GREEN(0, 255, 0);
+constexpr Color COLOR_BLUE(0, 0, 255);
+constexpr Color COLOR_INDIGO(75, 0, 130);
+constexpr Color COLOR_VIOLET(148, 0, 211);
+constexpr Color COLOR_WHITE(255, 255, 255);
+constexpr Color COLOR_CYAN(0, 255, 255);
+constexpr Color COLOR_SILVER(192, 192, 192);
+constexpr Color COLOR_BRONZE(205, 127, 50);
+constexpr Color COLOR_DEEP_SKY_BLUE(0, 191, 255);
+constexpr Color COLOR_DARK_GREEN(0, 100, 0);
+constexpr Color COLOR_GRAY(103, 110, 106);
+
 #endif
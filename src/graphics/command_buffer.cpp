@@ -0,0 +1,176 @@
+#include "command_buffer.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <algorithm>
+#include <new>
+
+/* Constructor */
+CommandBuffer::CommandBuffer() : block_(0), block_used_(0) {}
+
+/* Destructor */
+CommandBuffer::~CommandBuffer() {
+  for (unsigned int i = 0; i < blocks_.size(); i++) {
+    free(blocks_[i]);
+  }
+}
+
+/* Record a rastered polygon, see Framebuffer::DrawRasteredPolygon */
+void CommandBuffer::DrawRasteredPolygon(const Polygon& polygon, const Color& border_color, const Color& fill_color, const Point& top_left, const Point& bottom_right, int xoffset, int yoffset) {
+  RecordPolygon(polygon.GetShape(), border_color, fill_color, top_left, bottom_right, xoffset, yoffset);
+}
+
+/* Record a rastered polygon moved by a transform, see Framebuffer::DrawRasteredPolygon */
+void CommandBuffer::DrawRasteredPolygon(const Polygon& polygon, const Transform2D& transform, const Color& border_color, const Color& fill_color, const Point& top_left, const Point& bottom_right) {
+  /* Whole pixel moves copy the cached edge table of the polygon */
+  if (transform.IsPixelTranslation()) {
+    DrawRasteredPolygon(polygon, border_color, fill_color, top_left, bottom_right, transform.GetXOffset(), transform.GetYOffset());
+    return;
+  }
+
+  int point_count = polygon.GetNumOfPoints();
+  transformed_xs_.resize(point_count);
+  transformed_ys_.resize(point_count);
+  transform.Apply(polygon.GetXs(), polygon.GetYs(), point_count, transformed_xs_.data(), transformed_ys_.data());
+  transformed_table_.Build(transformed_xs_.data(), transformed_ys_.data(), point_count);
+  PolygonShape shape = Polygon::MakeShape(transformed_xs_.data(), transformed_ys_.data(), point_count, transformed_table_);
+  RecordPolygon(shape, border_color, fill_color, top_left, bottom_right, 0, 0);
+}
+
+/* Record every polygon of a sprite, see Framebuffer::DrawSprite */
+void CommandBuffer::DrawSprite(const Sprite& sprite, int xoffset, int yoffset) {
+  /* The framebuffer clips to the screen when it runs the commands, so the
+  recorded rectangle only has to hold every point a coordinate can */
+  DrawClippedSprite(sprite, Point(COORD_MIN_INT, COORD_MIN_INT), Point(COORD_MAX_INT, COORD_MAX_INT), xoffset, yoffset);
+}
+
+/* Record every polygon of a sprite, see Framebuffer::DrawClippedSprite */
+void CommandBuffer::DrawClippedSprite(const Sprite& sprite, const Point& top_left, const Point& bottom_right, int xoffset, int yoffset) {
+  const PolygonShape *shapes = sprite.GetShapes();
+  for (int i = 0; i < sprite.GetPolygonCount(); i++) {
+    const SpritePolygon& polygon = sprite.GetPolygon(i);
+    RecordPolygon(shapes[i], polygon.border_color, polygon.fill_color, top_left, bottom_right, xoffset, yoffset);
+  }
+}
+
+/* Record a clipped line, see Framebuffer::ClipLine */
+void CommandBuffer::ClipLine(const Point& p1, const Point& p2, const Point& top_left, const Point& bottom_right, const Color& color) {
+  DrawCommand& command = AddCommand(COMMAND_LINE, 2, 0);
+  command.border_color = color;
+  command.top_left = top_left;
+  command.bottom_right = bottom_right;
+  command.x_min = std::max(std::min(p1.GetX(), p2.GetX()), top_left.GetX());
+  command.y_min = std::max(std::min(p1.GetY(), p2.GetY()), top_left.GetY());
+  command.x_max = std::min(std::max(p1.GetX(), p2.GetX()), bottom_right.GetX());
+  command.y_max = std::min(std::max(p1.GetY(), p2.GetY()), bottom_right.GetY());
+  Coord *xs = (Coord*) command.shape.xs;
+  Coord *ys = (Coord*) command.shape.ys;
+  xs[0] = p1.GetCoordX();
+  ys[0] = p1.GetCoordY();
+  xs[1] = p2.GetCoordX();
+  ys[1] = p2.GetCoordY();
+}
+
+/* Record a filled circle, see Framebuffer::DrawFilledCircle */
+void CommandBuffer::DrawFilledCircle(const Point& center, int radius, const Color& border_color, const Color& fill_color) {
+  DrawCommand& command = AddCommand(COMMAND_FILLED_CIRCLE, 1, 0);
+  command.border_color = border_color;
+  command.fill_color = fill_color;
+  command.radius = radius;
+  command.x_min = center.GetX() - radius;
+  command.y_min = center.GetY() - radius;
+  command.x_max = center.GetX() + radius;
+  command.y_max = center.GetY() + radius;
+  *(Coord*) command.shape.xs = center.GetCoordX();
+  *(Coord*) command.shape.ys = center.GetCoordY();
+}
+
+/* Drop every command, keeping the arena for the next recording */
+void CommandBuffer::Reset() {
+  commands_.clear();
+  block_ = 0;
+  block_used_ = 0;
+}
+
+/* Getter */
+int CommandBuffer::GetCommandCount() const {
+  return commands_.size();
+}
+
+const DrawCommand& CommandBuffer::GetCommand(int idx) const {
+  return *commands_[idx];
+}
+
+long CommandBuffer::GetArenaSize() const {
+  long size = 0;
+  for (unsigned int i = 0; i < block_sizes_.size(); i++) {
+    size += block_sizes_[i];
+  }
+  return size;
+}
+
+/* Reserve size bytes (8 byte aligned) in the arena */
+void *CommandBuffer::Allocate(long size) {
+  size = (size + 7) & ~7L;
+  while (block_ < blocks_.size() && block_used_ + size > block_sizes_[block_]) {
+    block_++;
+    block_used_ = 0;
+  }
+  if (block_ == blocks_.size()) {
+    long block_size = std::max<long>(COMMAND_BLOCK_SIZE, size);
+    uint8_t *block = (uint8_t*) malloc(block_size);
+    if (!block) {
+      perror("Error: failed to allocate command buffer");
+      exit(7);
+    }
+    blocks_.push_back(block);
+    block_sizes_.push_back(block_size);
+  }
+  void *memory = blocks_[block_] + block_used_;
+  block_used_ += size;
+  return memory;
+}
+
+/* Add a command with room for point_count points and edge_count edges */
+DrawCommand& CommandBuffer::AddCommand(CommandType type, int point_count, int edge_count) {
+  long coordinates_size = point_count * sizeof(Coord);
+  long edges_size = edge_count * sizeof(Edge);
+  long size = sizeof(DrawCommand) + edges_size + 2 * coordinates_size;
+  uint8_t *memory = (uint8_t*) Allocate(size);
+  DrawCommand *command = new (memory) DrawCommand();
+  command->type = type;
+  command->xoffset = 0;
+  command->yoffset = 0;
+  command->radius = 0;
+  /* Edges hold 64 bit fields, so they go first to stay 8 byte aligned */
+  command->shape.edges = (const Edge*) (memory + sizeof(DrawCommand));
+  command->shape.edge_count = edge_count;
+  command->shape.xs = (const Coord*) (memory + sizeof(DrawCommand) + edges_size);
+  command->shape.ys = (const Coord*) (memory + sizeof(DrawCommand) + edges_size + coordinates_size);
+  command->shape.point_count = point_count;
+  commands_.push_back(command);
+  return *command;
+}
+
+/* Add a polygon command with a copy of the points and edges of a shape */
+void CommandBuffer::RecordPolygon(const PolygonShape& shape, const Color& border_color, const Color& fill_color, const Point& top_left, const Point& bottom_right, int xoffset, int yoffset) {
+  DrawCommand& command = AddCommand(COMMAND_POLYGON, shape.point_count, shape.edge_count);
+  command.border_color = border_color;
+  command.fill_color = fill_color;
+  command.top_left = top_left;
+  command.bottom_right = bottom_right;
+  command.xoffset = xoffset;
+  command.yoffset = yoffset;
+  command.x_min = std::max(shape.x_min + xoffset, top_left.GetX());
+  command.y_min = std::max(shape.y_min + yoffset, top_left.GetY());
+  command.x_max = std::min(shape.x_max + xoffset, bottom_right.GetX());
+  command.y_max = std::min(shape.y_max + yoffset, bottom_right.GetY());
+
+  /* Edges do not depend on the offset, so the shape's own table is copied */
+  std::copy(shape.xs, shape.xs + shape.point_count, (Coord*) command.shape.xs);
+  std::copy(shape.ys, shape.ys + shape.point_count, (Coord*) command.shape.ys);
+  std::copy(shape.edges, shape.edges + shape.edge_count, (Edge*) command.shape.edges);
+  command.shape.x_min = shape.x_min;
+  command.shape.x_max = shape.x_max;
+  command.shape.y_min = shape.y_min;
+  command.shape.y_max = shape.y_max;
+}
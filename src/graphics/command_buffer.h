@@ -0,0 +1,101 @@
+#ifndef COMMAND_BUFFER_H
+#define COMMAND_BUFFER_H
+
+#include <stdint.h>
+#include <vector>
+#include "point.h"
+#include "polygon.h"
+#include "sprite.h"
+#include "transform.h"
+#include "edge_table.h"
+#include "color.h"
+
+/* Size of the arena blocks commands and their points are stored in */
+#define COMMAND_BLOCK_SIZE (64 * 1024)
+
+enum CommandType {
+  COMMAND_POLYGON,       /* DrawRasteredPolygon */
+  COMMAND_LINE,          /* ClipLine, shape.xs and shape.ys hold both end points */
+  COMMAND_FILLED_CIRCLE  /* DrawFilledCircle, shape.xs and shape.ys hold the center */
+};
+
+/* One recorded draw call. Its points and edges are stored right after it in
+the arena */
+struct DrawCommand {
+  CommandType type;
+  Color border_color;
+  Color fill_color;
+  Point top_left; /* clip rectangle */
+  Point bottom_right;
+  int xoffset;
+  int yoffset;
+  int radius;
+  int x_min; /* bounding box on the screen, clipped to the clip rectangle */
+  int y_min;
+  int x_max;
+  int y_max;
+  PolygonShape shape;
+};
+
+/* Draw calls recorded for a Framebuffer to run later (see Framebuffer::Execute).
+Recorded commands stay valid until Reset(), so a list can be run again on
+later frames without recording it again */
+class CommandBuffer {
+public:
+  /* Constructor */
+  CommandBuffer();
+
+  /* Destructor */
+  ~CommandBuffer();
+
+  /* Record a rastered polygon, see Framebuffer::DrawRasteredPolygon */
+  void DrawRasteredPolygon(const Polygon& polygon, const Color& border_color, const Color& fill_color, const Point& top_left, const Point& bottom_right, int xoffset = 0, int yoffset = 0);
+
+  /* Record a rastered polygon moved by a transform, see Framebuffer::DrawRasteredPolygon */
+  void DrawRasteredPolygon(const Polygon& polygon, const Transform2D& transform, const Color& border_color, const Color& fill_color, const Point& top_left, const Point& bottom_right);
+
+  /* Record every polygon of a sprite, see Framebuffer::DrawSprite */
+  void DrawSprite(const Sprite& sprite, int xoffset = 0, int yoffset = 0);
+
+  /* Record every polygon of a sprite, see Framebuffer::DrawClippedSprite */
+  void DrawClippedSprite(const Sprite& sprite, const Point& top_left, const Point& bottom_right, int xoffset = 0, int yoffset = 0);
+
+  /* Record a clipped line, see Framebuffer::ClipLine */
+  void ClipLine(const Point& p1, const Point& p2, const Point& top_left, const Point& bottom_right, const Color& color);
+
+  /* Record a filled circle, see Framebuffer::DrawFilledCircle */
+  void DrawFilledCircle(const Point& center, int radius, const Color& border_color, const Color& fill_color);
+
+  /* Drop every command, keeping the arena for the next recording */
+  void Reset();
+
+  /* Getter */
+  int GetCommandCount() const;
+  const DrawCommand& GetCommand(int idx) const;
+  long GetArenaSize() const; /* bytes of arena memory held */
+
+private:
+  /* No copies, commands point into the arena */
+  CommandBuffer(const CommandBuffer&);
+  CommandBuffer& operator=(const CommandBuffer&);
+
+  /* Reserve size bytes (8 byte aligned) in the arena */
+  void *Allocate(long size);
+
+  /* Add a command with room for point_count points and edge_count edges */
+  DrawCommand& AddCommand(CommandType type, int point_count, int edge_count);
+
+  /* Add a polygon command with a copy of the points and edges of a shape */
+  void RecordPolygon(const PolygonShape& shape, const Color& border_color, const Color& fill_color, const Point& top_left, const Point& bottom_right, int xoffset, int yoffset);
+
+  std::vector<uint8_t*> blocks_;
+  std::vector<long> block_sizes_;
+  unsigned int block_;  /* block being filled */
+  long block_used_; /* bytes used in it */
+  std::vector<DrawCommand*> commands_;
+  CoordArray transformed_xs_; /* scratch space of the transformed draw calls */
+  CoordArray transformed_ys_;
+  EdgeTable transformed_table_;
+};
+
+#endif
@@ -0,0 +1,83 @@
+#include "edge_table.h"
+#include "bounding_box.h"
+#include <algorithm>
+
+/* Orders edges by their first scanline */
+static bool IsEdgeAbove(const Edge& edge1, const Edge& edge2) {
+  return edge1.y_top < edge2.y_top;
+}
+
+/* Constructor */
+EdgeTable::EdgeTable() : xmin_(0), xmax_(-1), ymin_(0), ymax_(-1) {}
+
+/* Rebuild the table from the count points (xs[i], ys[i]) of a polygon */
+void EdgeTable::Build(const Coord *xs, const Coord *ys, int count) {
+  edges_.clear();
+  if (count == 0) {
+    xmin_ = ymin_ = 0;
+    xmax_ = ymax_ = -1;
+    return;
+  }
+
+  /* Rounding keeps the order, so the box of the rounded points is the
+  rounded box */
+  BoundingBox box = BoundingBox::Of(xs, ys, count);
+  xmin_ = box.GetXMin();
+  xmax_ = box.GetXMax();
+  ymin_ = box.GetYMin();
+  ymax_ = box.GetYMax();
+
+  /* Edges keep the 24.8 endpoints and are sampled at pixel centres, so a
+  scanline y crosses an edge when y_a <= y < y_b in coordinate units */
+  Coord x0 = xs[count - 1];
+  Coord y0 = ys[count - 1];
+  for (int i = 0; i < count; i++) {
+    Coord x1 = xs[i];
+    Coord y1 = ys[i];
+    bool is_down = y0 < y1;
+    Coord x_top = is_down ? x0 : x1;
+    Coord y_top = is_down ? y0 : y1;
+    Coord x_bottom = is_down ? x1 : x0;
+    Coord y_bottom = is_down ? y1 : y0;
+
+    /* Edges between two pixel centres never cross a scanline, the outline
+    draws them */
+    Edge edge;
+    edge.y_top = (y_top + COORD_ONE - 1) >> COORD_SHIFT;
+    edge.y_bottom = (y_bottom + COORD_ONE - 1) >> COORD_SHIFT;
+    if (edge.y_top != edge.y_bottom) {
+      /* x at the first covered pixel centre and the step per scanline,
+      both 16.16 */
+      int64_t width = (int64_t) (x_bottom - x_top) * (65536 / COORD_ONE);
+      int64_t height = y_bottom - y_top;
+      int64_t y_skip = (int64_t) edge.y_top * COORD_ONE - y_top;
+      edge.x = (int64_t) x_top * (65536 / COORD_ONE) + y_skip * width / height;
+      edge.dx = width * COORD_ONE / height;
+      edges_.push_back(edge);
+    }
+    x0 = x1;
+    y0 = y1;
+  }
+  std::sort(edges_.begin(), edges_.end(), IsEdgeAbove);
+}
+
+/* Getter */
+const std::vector<Edge>& EdgeTable::GetEdges() const {
+  return edges_;
+}
+
+int EdgeTable::GetXMin() const {
+  return xmin_;
+}
+
+int EdgeTable::GetXMax() const {
+  return xmax_;
+}
+
+int EdgeTable::GetYMin() const {
+  return ymin_;
+}
+
+int EdgeTable::GetYMax() const {
+  return ymax_;
+}
@@ -0,0 +1,49 @@
+#ifndef EDGE_TABLE_H
+#define EDGE_TABLE_H
+
+#include <stdint.h>
+#include <vector>
+#include "fixed.h"
+
+/* A non horizontal polygon edge, covering scanlines y_top <= y < y_bottom.
+x is 64 bits wide as zoomed views move points far past 32768 pixels */
+struct Edge {
+  int y_top;
+  int y_bottom;
+  int64_t x;  /* x at scanline y_top (16.16 fixed point) */
+  int64_t dx; /* x step per scanline (16.16 fixed point) */
+};
+
+/* Edge of the active edge list while scanning a polygon */
+struct ActiveEdge {
+  int64_t x;  /* x at the current scanline (16.16 fixed point) */
+  int64_t dx;
+  int y_bottom;
+};
+
+/* Polygon edges sorted by their first scanline, built once per shape and used
+by the scanline fill */
+class EdgeTable {
+public:
+  /* Constructor */
+  EdgeTable();
+
+  /* Rebuild the table from the count points (xs[i], ys[i]) of a polygon */
+  void Build(const Coord *xs, const Coord *ys, int count);
+
+  /* Getter */
+  const std::vector<Edge>& GetEdges() const;
+  int GetXMin() const;
+  int GetXMax() const;
+  int GetYMin() const;
+  int GetYMax() const;
+
+private:
+  std::vector<Edge> edges_;
+  int xmin_;
+  int xmax_;
+  int ymin_;
+  int ymax_;
+};
+
+#endif
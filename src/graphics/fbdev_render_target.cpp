@@ -0,0 +1,90 @@
+#include "fbdev_render_target.h"
+#include <fcntl.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+/* Constructor */
+FbdevRenderTarget::FbdevRenderTarget(const char *device_path, int bits_per_pixel, bool two_pages) {
+  // Open framebuffer device for reading and writing
+  device_ = open(device_path, O_RDWR);
+  if (device_ == -1) {
+    perror("Error: cannot open framebuffer device");
+    exit(1);
+  }
+
+  // Read and write settings to variable screen information
+  if (ioctl(device_, FBIOGET_VSCREENINFO, &vinfo_) == -1) {
+    perror("Error: failed to read variable screen information");
+    exit(3);
+  }
+  vinfo_.grayscale = 0;
+  vinfo_.bits_per_pixel = bits_per_pixel;
+  vinfo_.xoffset = 0;
+  vinfo_.yoffset = 0;
+
+  // Ask for a virtual screen twice as tall as the visible one if frames are to
+  // be page flipped, fall back to whatever the driver had if it refuses
+  struct fb_var_screeninfo requested_vinfo = vinfo_;
+  if (two_pages && requested_vinfo.yres_virtual < 2 * requested_vinfo.yres) {
+    requested_vinfo.yres_virtual = 2 * requested_vinfo.yres;
+  }
+  if (ioctl(device_, FBIOPUT_VSCREENINFO, &requested_vinfo) == 0) {
+    vinfo_ = requested_vinfo;
+  } else if (ioctl(device_, FBIOPUT_VSCREENINFO, &vinfo_) == -1) {
+    perror("Error: failed to write variable screen information");
+    exit(4);
+  }
+
+  // Read fixed screen information (line length depends on the new settings)
+  if (ioctl(device_, FBIOGET_FSCREENINFO, &finfo_) == -1) {
+    perror("Error: failed to read fixed screen information");
+    exit(2);
+  }
+
+  // Calculate screen memory size in bytes
+  memory_size_ = vinfo_.yres_virtual * finfo_.line_length;
+
+  // Map the device to memory
+  memory_ = (uint8_t*) mmap(0, memory_size_, PROT_READ | PROT_WRITE, MAP_SHARED, device_, 0);
+  if (memory_ == MAP_FAILED) {
+    perror("Error: failed to map framebuffer device to memory");
+    exit(5);
+  }
+
+  width_ = vinfo_.xres;
+  height_ = vinfo_.yres;
+  virtual_height_ = vinfo_.yres_virtual;
+  line_length_ = finfo_.line_length;
+  bits_per_pixel_ = vinfo_.bits_per_pixel;
+}
+
+/* Pan the display to the rows starting at y_offset with FBIOPAN_DISPLAY */
+bool FbdevRenderTarget::Pan(long y_offset) {
+  if (y_offset == y_offset_) {
+    return true;
+  }
+  if (finfo_.ypanstep == 0 || y_offset % finfo_.ypanstep != 0 || y_offset + height_ > virtual_height_) {
+    return false;
+  }
+
+  // Not every driver can wait for vertical sync, panning still works without it
+  int crtc = 0;
+  ioctl(device_, FBIO_WAITFORVSYNC, &crtc);
+
+  vinfo_.xoffset = 0;
+  vinfo_.yoffset = y_offset;
+  if (ioctl(device_, FBIOPAN_DISPLAY, &vinfo_) == -1) {
+    return false;
+  }
+  y_offset_ = y_offset;
+  return true;
+}
+
+/* Destructor */
+FbdevRenderTarget::~FbdevRenderTarget() {
+  munmap(memory_, memory_size_);
+  close(device_);
+}
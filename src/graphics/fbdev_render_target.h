@@ -0,0 +1,27 @@
+#ifndef FBDEV_RENDER_TARGET_H
+#define FBDEV_RENDER_TARGET_H
+
+#include <linux/fb.h>
+#include "render_target.h"
+
+/* Render target backed by a memory mapped linux framebuffer device */
+class FbdevRenderTarget : public RenderTarget {
+public:
+  /* Constructor (asks the driver for bits_per_pixel, the target keeps whatever
+  depth the driver settles on). With two_pages, it also asks for a virtual
+  screen twice as tall as the visible one so that frames can be page flipped */
+  FbdevRenderTarget(const char *device_path, int bits_per_pixel = 32, bool two_pages = false);
+
+  /* Destructor */
+  ~FbdevRenderTarget();
+
+  /* Pan the display to the rows starting at y_offset with FBIOPAN_DISPLAY */
+  bool Pan(long y_offset);
+
+private:
+  int device_;
+  struct fb_fix_screeninfo finfo_;
+  struct fb_var_screeninfo vinfo_;
+};
+
+#endif
@@ -0,0 +1,58 @@
+#ifndef FIXED_H
+#define FIXED_H
+
+#include <stdint.h>
+#include <math.h>
+
+/* Coordinates are 24.8 fixed point: whole pixels in the top 24 bits and
+1/256 pixel steps in the low 8 */
+#define COORD_SHIFT 8
+#define COORD_ONE (1 << COORD_SHIFT)
+
+/* Transform factors (scales, sines and cosines) are 16.16 fixed point */
+#define FACTOR_SHIFT 16
+#define FACTOR_ONE (1 << FACTOR_SHIFT)
+
+/* Whole pixels a coordinate can hold, values past them are saturated */
+#define COORD_MIN_INT (-(1 << (31 - COORD_SHIFT)))
+#define COORD_MAX_INT ((1 << (31 - COORD_SHIFT)) - 1)
+
+typedef int32_t Coord;
+typedef int32_t Factor;
+
+/* Coordinate of a whole pixel (saturated to the coordinate range) */
+inline Coord CoordFromInt(int value) {
+  if (value < COORD_MIN_INT) {
+    value = COORD_MIN_INT;
+  } else if (value > COORD_MAX_INT) {
+    value = COORD_MAX_INT;
+  }
+  return value * COORD_ONE;
+}
+
+/* Nearest coordinate to value (saturated to the coordinate range) */
+inline Coord CoordFromDouble(double value) {
+  if (value < COORD_MIN_INT) {
+    value = COORD_MIN_INT;
+  } else if (value > COORD_MAX_INT) {
+    value = COORD_MAX_INT;
+  }
+  return (Coord) lrint(value * COORD_ONE);
+}
+
+/* Nearest whole pixel of a coordinate (halves round up) */
+inline int CoordToInt(Coord value) {
+  return (value + COORD_ONE / 2) >> COORD_SHIFT;
+}
+
+/* Nearest factor to value */
+inline Factor FactorFromDouble(double value) {
+  return (Factor) lrint(value * FACTOR_ONE);
+}
+
+/* value * factor, rounded to the nearest coordinate */
+inline Coord MultiplyFactor(Coord value, Factor factor) {
+  return (Coord) (((int64_t) value * factor + FACTOR_ONE / 2) >> FACTOR_SHIFT);
+}
+
+#endif
@@ -1,112 +1,233 @@
 #include "framebuffer.h"
-#include <fcntl.h>
+#include "fbdev_render_target.h"
+#include "pixel_kernels.h"
+#include "layer.h"
 #include <stdlib.h>
 #include <stdio.h>
-#include <sys/ioctl.h>
-#include <sys/mman.h>
-#include <unistd.h>
 #include <cstring>
 #include <algorithm>
 
 /* Constructor */
-Framebuffer::Framebuffer(const char *device_path) {
-  // Open framebuffer device for reading and writing
-	device_ = open(device_path, O_RDWR);
-  if (device_ == -1) {
-    perror("Error: cannot open framebuffer device");
-    exit(1);
+Framebuffer::Framebuffer(const char *device_path, int bits_per_pixel, bool two_pages) {
+  target_ = new FbdevRenderTarget(device_path, bits_per_pixel, two_pages);
+  Init();
+}
+
+Framebuffer::Framebuffer(RenderTarget *target) {
+  target_ = target;
+  Init();
+}
+
+/* Destructor */
+Framebuffer::~Framebuffer() {
+  SetPageFlipping(false);
+  delete raster_pool_;
+  free(heap_buffer_);
+  delete target_;
+}
+
+/* Read the screen layout from the render target and allocate the buffer */
+void Framebuffer::Init() {
+  address_ = target_->GetMemory();
+  width_ = target_->GetWidth();
+  height_ = target_->GetHeight();
+  bytes_per_pixel_ = target_->GetBitsPerPixel() / 8;
+  line_length_ = target_->GetLineLength();
+  screen_memory_size_ = height_ * line_length_;
+
+  switch (target_->GetBitsPerPixel()) {
+    case 16:
+      SelectPixelFormat<PixelRGB565>();
+      break;
+    case 24:
+      SelectPixelFormat<PixelRGB888>();
+      break;
+    case 32:
+      SelectPixelFormat<PixelXRGB8888>();
+      break;
+    default:
+      fprintf(stderr, "Error: unsupported pixel format (%d bits per pixel)\n", target_->GetBitsPerPixel());
+      exit(8);
+  }
+
+  /* Cache line aligned, so that band boundaries are too */
+  void *memory;
+  if (posix_memalign(&memory, CACHE_LINE_SIZE, screen_memory_size_) != 0) {
+    perror("Error: failed to allocate the framebuffer");
+    exit(6);
   }
+  heap_buffer_ = (uint8_t*) memory;
+  memset(heap_buffer_, 0, screen_memory_size_);
+  buffer_ = heap_buffer_;
+  page_flipping_ = false;
+  front_page_ = 0;
+
+  damage_mode_ = DAMAGE_TILES;
+  tiles_x_ = (width_ + DAMAGE_TILE_SIZE - 1) / DAMAGE_TILE_SIZE;
+  tiles_y_ = (height_ + DAMAGE_TILE_SIZE - 1) / DAMAGE_TILE_SIZE;
+  damaged_tiles_.assign(tiles_x_ * tiles_y_, 1);
+  tile_hashes_.assign(tiles_x_ * tiles_y_, 0);
+  tile_hash_valid_.assign(tiles_x_ * tiles_y_, 0);
+  last_presented_bytes_ = 0;
+
+  blend_mode_ = BLEND_ALPHA;
+
+  raster_pool_ = 0;
+  raster_threads_ = 1;
+  bands_.resize(1);
+  band_count_ = 0;
+  band_task_ = 0;
+  band_job_ = 0;
+}
+
+/* Point raster_ at the instantiations for Format */
+template <class Format>
+void Framebuffer::SelectPixelFormat() {
+  raster_.pack_color = &Format::Pack;
+  raster_.unpack_color = &Format::Unpack;
+  raster_.write_span = &Framebuffer::WriteRun<Format>;
+  raster_.put_pixel = &Framebuffer::PutPixel<Format>;
+  raster_.raster_span = &Framebuffer::RasterSpan<Format>;
+  raster_.raster_line = &Framebuffer::RasterLine<Format>;
+  raster_.raster_dotted_line = &Framebuffer::RasterDottedLine<Format>;
+  raster_.raster_polygon = &Framebuffer::RasterPolygon<Format>;
+  raster_.raster_circle = &Framebuffer::RasterCircle<Format>;
+  raster_.raster_filled_circle = &Framebuffer::RasterFilledCircle<Format>;
+  raster_.sprite_band = &Framebuffer::RasterSpriteBand<Format>;
+  raster_.fill_rect_band = &Framebuffer::FillRectBand<Format>;
+  raster_.execute_band = &Framebuffer::ExecuteBand<Format>;
+  raster_.composite_band = &Framebuffer::CompositeBand<Format>;
+  raster_.scaled_composite_band = &Framebuffer::ScaledCompositeBand<Format>;
+}
+
+/* Device pixel value of a color in the pixel format of the screen */
+uint32_t Framebuffer::PackColor(const Color& color) const {
+  return raster_.pack_color(color);
+}
+
+/* Set a pixel with specified color to the specified point in framebuffer */
+void Framebuffer::SetPixel(const Point& position, const Color& color) {
+  MarkDamaged(position.GetX(), position.GetY(), position.GetX(), position.GetY());
+  (this->*raster_.put_pixel)(position.GetX(), position.GetY(), PackColor(color), GetScreenBand());
+}
+
+/* Fill length pixels of row y starting at x with a device pixel value */
+void Framebuffer::WriteSpan(int x, int y, int length, uint32_t pixel) {
+  (this->*raster_.write_span)(x, y, length, pixel);
+}
 
-  // Read fixed screen information
-  if (ioctl(device_, FBIOGET_FSCREENINFO, &finfo_) == -1) {
-    perror("Error: failed to read fixed screen information");
-    exit(2);
+/* Fill length pixels of row y starting at x, without bounds checking or
+marking them as damaged */
+template <class Format>
+void Framebuffer::WriteRun(int x, int y, int length, uint32_t pixel) {
+  uint8_t *run = buffer_ + y * line_length_ + x * Format::BYTES;
+  if (IsOpaqueWrite(pixel)) {
+    Format::Fill(run, pixel, length, page_flipping_);
+  } else {
+    Format::Blend(run, pixel, length);
   }
+}
 
-	// Read and write settings to variable screen information
-	if (ioctl(device_, FBIOGET_VSCREENINFO, &vinfo_) == -1) {
-    perror("Error: failed to read variable screen information");
-    exit(3);
+/* Fill the pixels from x0 to x1 (inclusive) of row y with the specified color,
+clipped to the screen */
+void Framebuffer::FillSpan(int y, int x0, int x1, const Color& color) {
+  if (x0 > x1) {
+    std::swap(x0, x1);
   }
-	vinfo_.grayscale = 0;
-	vinfo_.bits_per_pixel = 32;
-	vinfo_.xoffset = 0;
-	vinfo_.yoffset = 0;
-	if (ioctl(device_, FBIOPUT_VSCREENINFO, &vinfo_) == -1) {
-    perror("Error: failed to write variable screen information");
-    exit(4);
+  MarkDamaged(x0, y, x1, y);
+  (this->*raster_.raster_span)(y, x0, x1, PackColor(color), Point(0, 0), Point(width_ - 1, height_ - 1));
+}
 
+/* Fill the pixels from x0 to x1 (x0 <= x1) of row y, clipped to the clip
+rectangle and the screen, without marking them as damaged */
+template <class Format>
+void Framebuffer::RasterSpan(int y, int x0, int x1, uint32_t pixel, const Point& top_left, const Point& bottom_right) {
+  if (y < top_left.GetY() || y > bottom_right.GetY() || y < 0 || y >= height_) {
+    return;
   }
+  x0 = std::max(x0, std::max(top_left.GetX(), 0));
+  x1 = std::min<long>(x1, std::min<long>(bottom_right.GetX(), width_ - 1));
+  if (x0 <= x1) {
+    WriteRun<Format>(x0, y, x1 - x0 + 1, pixel);
+  }
+}
 
-  // Calculate screen memory size in bytes
-	screen_memory_size_ = vinfo_.yres_virtual * finfo_.line_length;
+/* Set a pixel if it is inside a band, without marking it as damaged */
+template <class Format>
+void Framebuffer::PutPixel(int x, int y, uint32_t pixel, const RasterBand& band) {
+  if (IsInsideBand(x, y, band)) {
+    WritePixel<Format>(x, y, pixel);
+  }
+}
 
-  // Map the device to memory
-  address_ = (uint8_t*) mmap(0, screen_memory_size_, PROT_READ | PROT_WRITE, MAP_SHARED, device_, 0);
-  if (!address_) {
-    perror("Error: failed to map framebuffer device to memory");
-    exit(5);
+/* Set a pixel without bounds checking or marking it as damaged */
+template <class Format>
+void Framebuffer::WritePixel(int x, int y, uint32_t pixel) {
+  uint8_t *position = buffer_ + y * line_length_ + x * Format::BYTES;
+  if (IsOpaqueWrite(pixel)) {
+    Format::Write(position, pixel);
+  } else {
+    Format::Blend(position, pixel, 1);
   }
+}
 
-  buffer_ = new uint8_t[screen_memory_size_];
+/* Checks whether a packed pixel is written as it is rather than blended */
+bool Framebuffer::IsOpaqueWrite(uint32_t pixel) const {
+  return (pixel >> 24) == 0xff || blend_mode_ == BLEND_REPLACE;
 }
 
-/* Destructor */
-Framebuffer::~Framebuffer() {
-  delete[] buffer_;
-  munmap(address_, screen_memory_size_);
-  close(device_);
+/* Checks whether (x, y) is inside the screen */
+bool Framebuffer::IsInsideScreen(int x, int y) const {
+  return (unsigned long) x < (unsigned long) width_ && (unsigned long) y < (unsigned long) height_;
 }
 
-/* Set a pixel with specified color to the specified point in framebuffer */
-void Framebuffer::SetPixel(const Point& position, const Color& color) {
-  long int address_offset;
-  if ((unsigned int) position.GetX() >= 0 && (unsigned int) position.GetX() < vinfo_.xres &&
-      (unsigned int) position.GetY() >= 0 && (unsigned int) position.GetY() < vinfo_.yres) {
-    address_offset = position.GetX() * (vinfo_.bits_per_pixel/8) + position.GetY() * finfo_.line_length;
- 	  buffer_[address_offset] = color.GetB();
- 	  buffer_[address_offset + 1] = color.GetG();
- 	  buffer_[address_offset + 2] = color.GetR();
- 	  buffer_[address_offset + 3] = 0;
-  }
+/* Checks whether (x, y) is inside a band */
+bool Framebuffer::IsInsideBand(int x, int y, const RasterBand& band) const {
+  return x >= band.x_first && x <= band.x_last && y >= band.y_first && y <= band.y_last;
 }
 
 /* Draw a line with specified color from the specified start and end point
 in the framebuffer */
 void Framebuffer::DrawLine(const Point& start, const Point& end, const Color& color) {
+	MarkDamaged(std::min(start.GetX(), end.GetX()), std::min(start.GetY(), end.GetY()),
+	            std::max(start.GetX(), end.GetX()), std::max(start.GetY(), end.GetY()));
+	(this->*raster_.raster_line)(start, end, PackColor(color), GetScreenBand());
+}
+
+/* Draw the part of a line inside a band without marking it as damaged */
+template <class Format>
+void Framebuffer::RasterLine(const Point& start, const Point& end, uint32_t pixel, const RasterBand& band) {
+	int y0 = std::min(start.GetY(), end.GetY());
+	int y1 = std::max(start.GetY(), end.GetY());
+	if (y1 < band.y_first || y0 > band.y_last) {
+		return;
+	}
+	bool inside = IsInsideBand(start.GetX(), start.GetY(), band) && IsInsideBand(end.GetX(), end.GetY(), band);
+
 	if (start.GetX() == end.GetX()) {
 		int x = start.GetX();
-		if (start.GetY() < end.GetY()) {
-			for (int y = start.GetY(); y <= end.GetY(); y++) {
-				SetPixel(Point(x, y), color);
-			}
-		} else {
-			for (int y = end.GetY(); y <= start.GetY(); y++) {
-				SetPixel(Point(x, y), color);
-			}
+		if (x < band.x_first || x > band.x_last) {
+			return;
 		}
-	} else if (start.GetY() == end.GetY()) {
-		int y = start.GetY();
-		if (start.GetX() < end.GetX()) {
-			for (int x = start.GetX(); x <= end.GetX(); x++) {
-				SetPixel(Point(x, y), color);
-			}
-		} else {
-			for (int x = end.GetX(); x <= start.GetX(); x++) {
-				SetPixel(Point(x, y), color);
-			}
+		y0 = std::max(y0, band.y_first);
+		y1 = std::min(y1, band.y_last);
+		for (int y = y0; y <= y1; y++) {
+			WritePixel<Format>(x, y, pixel);
 		}
+	} else if (start.GetY() == end.GetY()) {
+		RasterSpan<Format>(start.GetY(), std::min(start.GetX(), end.GetX()), std::max(start.GetX(), end.GetX()), pixel,
+		           Point(band.x_first, band.y_first), Point(band.x_last, band.y_last));
 	} else if (abs(end.GetY() - start.GetY()) < abs(end.GetX() - start.GetX())) {
 		if (start.GetX() > end.GetX()) {
-			DrawLineLow(end, start, color);
+			DrawLineLow<Format>(end, start, pixel, band, inside);
 		} else {
-			DrawLineLow(start, end, color);
+			DrawLineLow<Format>(start, end, pixel, band, inside);
 		}
 	} else {
 		if (start.GetY() > end.GetY()) {
-			DrawLineHigh(end, start, color);
+			DrawLineHigh<Format>(end, start, pixel, band, inside);
 		} else {
-			DrawLineHigh(start, end, color);
+			DrawLineHigh<Format>(start, end, pixel, band, inside);
 		}
 	}
 }
@@ -114,7 +235,8 @@ void Framebuffer::DrawLine(const Point& start, const Point& end, const Color& co
 
 /* Draw a line with specified color from the specified start and end point
 with low gradient (0 < m < 1 or -1 < m < 0) in the framebuffer using Bresenham algorithm */
-void Framebuffer::DrawLineLow(const Point& start, const Point& end, const Color& color) {
+template <class Format>
+void Framebuffer::DrawLineLow(const Point& start, const Point& end, uint32_t pixel, const RasterBand& band, bool inside) {
 	int dx = end.GetX() - start.GetX();
 	int dy = end.GetY() - start.GetY();
 
@@ -129,8 +251,28 @@ void Framebuffer::DrawLineLow(const Point& start, const Point& end, const Color&
 	int p = 2 * dy - dx;
 	int y = start.GetY();
 
+	if (inside) {
+		/* Pixels between two steps in y form a horizontal run */
+		int run_start = start.GetX();
+		for (int x = start.GetX(); x <= end.GetX(); x++) {
+			if (p > 0) {
+				WriteRun<Format>(run_start, y, x - run_start + 1, pixel);
+				run_start = x + 1;
+				y += yi;
+				p -= (2 * dx);
+			}
+			p += (2 * dy);
+		}
+		if (run_start <= end.GetX()) {
+			WriteRun<Format>(run_start, y, end.GetX() - run_start + 1, pixel);
+		}
+		return;
+	}
+
 	for (int x = start.GetX(); x <= end.GetX(); x++) {
-		SetPixel(Point(x, y), color);
+		if (IsInsideBand(x, y, band)) {
+			WritePixel<Format>(x, y, pixel);
+		}
 		if (p > 0) {
 			y += yi;
 			p -= (2 * dx);
@@ -141,7 +283,8 @@ void Framebuffer::DrawLineLow(const Point& start, const Point& end, const Color&
 
 /* Draw a line with specified color from the specified start and end point
 with steep gradient (> 1 or < -1) in the framebuffer using Bresenham algorithm */
-void Framebuffer::DrawLineHigh(const Point& start, const Point& end, const Color& color) {
+template <class Format>
+void Framebuffer::DrawLineHigh(const Point& start, const Point& end, uint32_t pixel, const RasterBand& band, bool inside) {
 	int dx = end.GetX() - start.GetX();
 	int dy = end.GetY() - start.GetY();
 
@@ -156,7 +299,9 @@ void Framebuffer::DrawLineHigh(const Point& start, const Point& end, const Color
 	int x = start.GetX();
 
 	for (int y = start.GetY(); y <= end.GetY(); y++) {
-		SetPixel(Point(x, y), color);
+		if (inside || IsInsideBand(x, y, band)) {
+			WritePixel<Format>(x, y, pixel);
+		}
 		if (p > 0) {
 			x += xi;
 			p -= (2 * dy);
@@ -165,9 +310,77 @@ void Framebuffer::DrawLineHigh(const Point& start, const Point& end, const Color
 	}
 }
 
+/* Draw the part of a polygon edge between 24.8 end points inside a band.
+Whole pixel end points take the Bresenham line, others are sampled at pixel
+centres along the major axis and rounded like CoordToInt */
+template <class Format>
+void Framebuffer::RasterEdge(Coord x0, Coord y0, Coord x1, Coord y1, uint32_t pixel, const RasterBand& band) {
+	if (((x0 | y0 | x1 | y1) & (COORD_ONE - 1)) == 0) {
+		RasterLine<Format>(Point(x0 >> COORD_SHIFT, y0 >> COORD_SHIFT), Point(x1 >> COORD_SHIFT, y1 >> COORD_SHIFT), pixel, band);
+		return;
+	}
+
+	/* Steep edges swap the axes so that the major axis is always x */
+	bool is_steep = abs(y1 - y0) > abs(x1 - x0);
+	if (is_steep) {
+		std::swap(x0, y0);
+		std::swap(x1, y1);
+	}
+	if (x0 > x1) {
+		std::swap(x0, x1);
+		std::swap(y0, y1);
+	}
+	int first = std::max(CoordToInt(x0), is_steep ? band.y_first : band.x_first);
+	int last = std::min(CoordToInt(x1), is_steep ? band.y_last : band.x_last);
+	if (first > last) {
+		return;
+	}
+
+	/* The minor axis at the pixel centre m is y0 + (m - x0) * height / width,
+	kept as whole pixels and a remainder over COORD_ONE * width. The first and
+	last pixels may lie up to half a pixel past the end points, so the minor
+	axis is clamped to the rounded end points */
+	int64_t width = std::max(x1 - x0, 1);
+	int64_t height = y1 - y0;
+	int64_t denominator = width * COORD_ONE;
+	int64_t numerator = y0 * width + ((int64_t) first * COORD_ONE - x0) * height + COORD_ONE / 2 * width;
+	int64_t minor = numerator / denominator;
+	int64_t remainder = numerator % denominator;
+	if (remainder < 0) {
+		minor--;
+		remainder += denominator;
+	}
+	int minor_min = CoordToInt(std::min(y0, y1));
+	int minor_max = CoordToInt(std::max(y0, y1));
+	for (int m = first; m <= last; m++) {
+		int n = std::min(std::max((int) minor, minor_min), minor_max);
+		if (is_steep) {
+			PutPixel<Format>(n, m, pixel, band);
+		} else {
+			PutPixel<Format>(m, n, pixel, band);
+		}
+		remainder += height * COORD_ONE;
+		if (remainder >= denominator) {
+			minor++;
+			remainder -= denominator;
+		} else if (remainder < 0) {
+			minor--;
+			remainder += denominator;
+		}
+	}
+}
+
 /* Draw a dotted line with specified color from the specified start and end point
 in the framebuffer */
 void Framebuffer::DrawDottedLine(const Point& start, const Point& end, const Color& color, int interval) {
+	MarkDamaged(std::min(start.GetX(), end.GetX()), std::min(start.GetY(), end.GetY()),
+	            std::max(start.GetX(), end.GetX()), std::max(start.GetY(), end.GetY()));
+	(this->*raster_.raster_dotted_line)(start, end, PackColor(color), interval, GetScreenBand());
+}
+
+/* Draw the part of a dotted line inside a band without marking it as damaged */
+template <class Format>
+void Framebuffer::RasterDottedLine(const Point& start, const Point& end, uint32_t pixel, int interval, const RasterBand& band) {
 	bool draw = false;
 
 	if (start.GetX() == end.GetX()) {
@@ -178,7 +391,7 @@ void Framebuffer::DrawDottedLine(const Point& start, const Point& end, const Col
 					draw = !draw;
 				}
 				if (draw) {
-					SetPixel(Point(x, y), color);
+					PutPixel<Format>(x, y, pixel, band);
 				}
 			}
 		} else {
@@ -187,7 +400,7 @@ void Framebuffer::DrawDottedLine(const Point& start, const Point& end, const Col
 					draw = !draw;
 				}
 				if (draw) {
-					SetPixel(Point(x, y), color);
+					PutPixel<Format>(x, y, pixel, band);
 				}
 			}
 		}
@@ -199,7 +412,7 @@ void Framebuffer::DrawDottedLine(const Point& start, const Point& end, const Col
 					draw = !draw;
 				}
 				if (draw) {
-					SetPixel(Point(x, y), color);
+					PutPixel<Format>(x, y, pixel, band);
 				}
 			}
 		} else {
@@ -208,28 +421,29 @@ void Framebuffer::DrawDottedLine(const Point& start, const Point& end, const Col
 					draw = !draw;
 				}
 				if (draw) {
-					SetPixel(Point(x, y), color);
+					PutPixel<Format>(x, y, pixel, band);
 				}
 			}
 		}
 	} else if (abs(end.GetY() - start.GetY()) < abs(end.GetX() - start.GetX())) {
 		if (start.GetX() > end.GetX()) {
-			DrawDottedLineLow(end, start, color, interval);
+			DrawDottedLineLow<Format>(end, start, pixel, interval, band);
 		} else {
-			DrawDottedLineLow(start, end, color, interval);
+			DrawDottedLineLow<Format>(start, end, pixel, interval, band);
 		}
 	} else {
 		if (start.GetY() > end.GetY()) {
-			DrawDottedLineHigh(end, start, color, interval);
+			DrawDottedLineHigh<Format>(end, start, pixel, interval, band);
 		} else {
-			DrawDottedLineHigh(start, end, color, interval);
+			DrawDottedLineHigh<Format>(start, end, pixel, interval, band);
 		}
 	}
 }
 
 /* Draw a dotted line with specified color from the specified start and end point
 with low gradient (0 < m < 1 or -1 < m < 0) in the framebuffer using Bresenham algorithm */
-void Framebuffer::DrawDottedLineLow(const Point& start, const Point& end, const Color& color, int interval) {
+template <class Format>
+void Framebuffer::DrawDottedLineLow(const Point& start, const Point& end, uint32_t pixel, int interval, const RasterBand& band) {
 	int dx = end.GetX() - start.GetX();
 	int dy = end.GetY() - start.GetY();
 
@@ -250,7 +464,7 @@ void Framebuffer::DrawDottedLineLow(const Point& start, const Point& end, const
 			draw = !draw;
 		}
 		if (draw) {
-			SetPixel(Point(x, y), color);
+			PutPixel<Format>(x, y, pixel, band);
 		}
 		if (p > 0) {
 			y += yi;
@@ -262,7 +476,8 @@ void Framebuffer::DrawDottedLineLow(const Point& start, const Point& end, const
 
 /* Draw a dotted line with specified color from the specified start and end point
 with steep gradient (> 1 or < -1) in the framebuffer using Bresenham algorithm */
-void Framebuffer::DrawDottedLineHigh(const Point& start, const Point& end, const Color& color, int interval) {
+template <class Format>
+void Framebuffer::DrawDottedLineHigh(const Point& start, const Point& end, uint32_t pixel, int interval, const RasterBand& band) {
 	int dx = end.GetX() - start.GetX();
 	int dy = end.GetY() - start.GetY();
 
@@ -282,7 +497,7 @@ void Framebuffer::DrawDottedLineHigh(const Point& start, const Point& end, const
 			draw = !draw;
 		}
 		if (draw) {
-			SetPixel(Point(x, y), color);
+			PutPixel<Format>(x, y, pixel, band);
 		}
 		if (p > 0) {
 			x += xi;
@@ -301,259 +516,514 @@ void Framebuffer::DrawPolygon(const Polygon& polygon, const Color& color) {
 
 /* Draw a rastered polygon to the framebuffer */
 void Framebuffer::DrawRasteredPolygon(const Polygon& polygon, const Color& border_color, const Color& fill_color,  const Point& top_left, const Point& bottom_right, int xoffset, int yoffset) {
-		int ymin = 1000000;
-		int ymax = 0;
-		for (int i = 0; i < polygon.GetNumOfPoints(); i++) {
-			if (polygon.GetPoint(i).GetY() + yoffset < ymin) {
-				ymin = polygon.GetPoint(i).GetY() + yoffset;
-			}
-			if (polygon.GetPoint(i).GetY() + yoffset > ymax) {
-				ymax = polygon.GetPoint(i).GetY() + yoffset;
-			}
-		}
+	/* Polygons outside the clip rectangle never get an edge table */
+	if (polygon.GetBoundingBox().IsOutside(top_left, bottom_right, xoffset, yoffset)) {
+		return;
+	}
 
-		std::vector<std::vector<int>> intersections(ymax - ymin + 1);
-
-		int prev, next;
-		for (int i = 0; i < polygon.GetNumOfPoints(); i++) {
-	    prev = i - 1;
-	    next = i + 1;
-	    if (prev < 0) {
-	      prev = polygon.GetNumOfPoints() - 1;
-	    }
-			if (next == polygon.GetNumOfPoints()) {
-	      next = 0;
-	    }
-			SetRasteredPolygonIntersections(polygon.GetPoint(i).Translate(Point(xoffset, yoffset)), polygon.GetPoint(next).Translate(Point(xoffset, yoffset)), intersections, ymin);
-
-			/* Corner points case */
-	    if ((polygon.GetPoint(i).GetY() > polygon.GetPoint(next).GetY() && polygon.GetPoint(i).GetY() < polygon.GetPoint(prev).GetY()) ||
-	        (polygon.GetPoint(i).GetY() < polygon.GetPoint(next).GetY() && polygon.GetPoint(i).GetY() > polygon.GetPoint(prev).GetY())) {
-	          intersections[polygon.GetPoint(i).GetY() + yoffset - ymin].push_back(polygon.GetPoint(i).GetX() + xoffset);
-	    }
-	    if (polygon.GetPoint(i).GetY() == polygon.GetPoint(next).GetY()) {
-	      if (polygon.GetPoint(i).GetY() < polygon.GetPoint(prev).GetY()) {
-	        intersections[polygon.GetPoint(i).GetY() + yoffset - ymin].push_back(polygon.GetPoint(i).GetX() + xoffset);
-	      }
-	      if (polygon.GetPoint(next).GetY() < polygon.GetPoint((next + 1) % polygon.GetNumOfPoints()).GetY()) {
-	        intersections[polygon.GetPoint(next).GetY() + yoffset - ymin].push_back(polygon.GetPoint(next).GetX() + xoffset);
-	      }
-	    }
-	  }
-
-		/* Sort intersection points */
-		for (int i = 1; i < (ymax - ymin); i++) {
-			std::sort(intersections[i].begin(), intersections[i].end());
-		}
-
-		/* Fill polygon */
-	  for (int i = 1; i < (ymax - ymin); i++) {
-			if (intersections[i].size() > 1) {
-				for (unsigned int j = 0; j < intersections[i].size() - 1; j += 2) {
-						ClipLine(Point(intersections[i][j] + 1, ymin + i), Point(intersections[i][j + 1] - 1, ymin + i), top_left, bottom_right, fill_color);
-				}
-			}
-		}
+	const EdgeTable& edge_table = polygon.GetEdgeTable();
+	MarkDamaged(std::max(edge_table.GetXMin() + xoffset, top_left.GetX()), std::max(edge_table.GetYMin() + yoffset, top_left.GetY()),
+	            std::min(edge_table.GetXMax() + xoffset, bottom_right.GetX()), std::min(edge_table.GetYMax() + yoffset, bottom_right.GetY()));
 
-		/* Draw polygon outlines */
-		for (int i = 0; i < polygon.GetNumOfPoints(); i++) {
-			next = i + 1;
-			if (next == polygon.GetNumOfPoints()) {
-				next = 0;
-			}
-			ClipLine(polygon.GetPoint(i).Translate(Point(xoffset, yoffset)), polygon.GetPoint(next).Translate(Point(xoffset, yoffset)), top_left, bottom_right, border_color);
+	(this->*raster_.raster_polygon)(polygon.GetShape(), PackColor(border_color), PackColor(fill_color), top_left, bottom_right, xoffset, yoffset, GetScreenBand());
+}
+
+/* Draw a rastered polygon moved by a transform */
+void Framebuffer::DrawRasteredPolygon(const Polygon& polygon, const Transform2D& transform, const Color& border_color, const Color& fill_color, const Point& top_left, const Point& bottom_right) {
+	/* Whole pixel moves reuse the cached edge table of the polygon */
+	if (transform.IsPixelTranslation()) {
+		DrawRasteredPolygon(polygon, border_color, fill_color, top_left, bottom_right, transform.GetXOffset(), transform.GetYOffset());
+		return;
 	}
+	if (polygon.GetBoundingBox().Transform(transform).IsOutside(top_left, bottom_right)) {
+		return;
+	}
+
+	SpritePolygon whole;
+	whole.first_point = 0;
+	whole.point_count = polygon.GetNumOfPoints();
+	TransformShapes(polygon.GetXs(), polygon.GetYs(), &whole, NULL, NULL, 1, transform, top_left, bottom_right);
+	const PolygonShape& shape = transformed_shapes_[0];
+	MarkDamaged(std::max(shape.x_min, top_left.GetX()), std::max(shape.y_min, top_left.GetY()),
+	            std::min(shape.x_max, bottom_right.GetX()), std::min(shape.y_max, bottom_right.GetY()));
+
+	(this->*raster_.raster_polygon)(shape, PackColor(border_color), PackColor(fill_color), top_left, bottom_right, 0, 0, GetScreenBand());
 }
 
+/* Fill and outline the part of a polygon inside a band, without marking it
+as damaged */
+template <class Format>
+void Framebuffer::RasterPolygon(const PolygonShape& shape, uint32_t border_pixel, uint32_t fill_pixel, const Point& top_left, const Point& bottom_right, int xoffset, int yoffset, RasterBand& band) {
+	int x_min = shape.x_min + xoffset;
+	int x_max = shape.x_max + xoffset;
+	int y_min = shape.y_min + yoffset;
+	int y_max = shape.y_max + yoffset;
+	if (y_max < band.y_first || y_min > band.y_last || x_max < band.x_first || x_min > band.x_last ||
+	    y_max < top_left.GetY() || y_min > bottom_right.GetY() || x_max < top_left.GetX() || x_min > bottom_right.GetX()) {
+		return;
+	}
 
-/* Set the rastered polygon line intersections */
-void Framebuffer::SetRasteredPolygonIntersections(const Point& start, const Point& end, std::vector<std::vector<int>>& intersections, int ymin) {
-	if (start.GetX() == end.GetX()) {
-		int x = start.GetX();
-		if (start.GetY() < end.GetY()) {
-			for (int y = start.GetY(); y <= end.GetY(); y++) {
-				intersections[y - ymin].push_back(x);
-			}
-		} else {
-			for (int y = end.GetY(); y <= start.GetY(); y++) {
-				intersections[y - ymin].push_back(x);
-			}
+	/* Fill polygon */
+	FillEdgeTable<Format>(shape, fill_pixel, top_left, bottom_right, xoffset, yoffset, band);
+
+	/* Draw polygon outlines from the 24.8 points, clipped as a whole so that
+	every band steps through the same pixels. Polygons inside the clip rectangle
+	skip the clipper */
+	bool is_inside = x_min >= top_left.GetX() && x_max <= bottom_right.GetX() && y_min >= top_left.GetY() && y_max <= bottom_right.GetY();
+	Coord coord_xoffset = CoordFromInt(xoffset);
+	Coord coord_yoffset = CoordFromInt(yoffset);
+	CoordSegments& segments = band.coord_segments;
+	segments.Reserve(shape.point_count);
+	for (int i = 0; i < shape.point_count; i++) {
+		int next = i + 1;
+		if (next == shape.point_count) {
+			next = 0;
 		}
-	} else if (start.GetY() == end.GetY()) {
-		int y = start.GetY();
-		if (start.GetX() < end.GetX()) {
-				intersections[y - ymin].push_back(start.GetX());
-				intersections[y - ymin].push_back(end.GetX());
-		} else {
-			intersections[y - ymin].push_back(end.GetX());
-			intersections[y - ymin].push_back(start.GetX());
+		segments.x0[i] = shape.xs[i] + coord_xoffset;
+		segments.y0[i] = shape.ys[i] + coord_yoffset;
+		segments.x1[i] = shape.xs[next] + coord_xoffset;
+		segments.y1[i] = shape.ys[next] + coord_yoffset;
+	}
+	int left = is_inside ? shape.point_count : LineClipper::Clip(segments, shape.point_count, top_left, bottom_right);
+	for (int i = 0; i < left; i++) {
+		RasterEdge<Format>(segments.x0[i], segments.y0[i], segments.x1[i], segments.y1[i], border_pixel, band);
+	}
+}
+
+/* Fill the inside of a polygon inside a band, scanline by scanline, with an
+active edge list */
+template <class Format>
+void Framebuffer::FillEdgeTable(const PolygonShape& shape, uint32_t pixel, const Point& top_left, const Point& bottom_right, int xoffset, int yoffset, RasterBand& band) {
+	const Edge *edges = shape.edges;
+	unsigned int edge_count = shape.edge_count;
+	int y_first = std::max(std::max(shape.y_min + yoffset, top_left.GetY()), band.y_first);
+	int y_last = std::min(std::min(shape.y_max + yoffset, bottom_right.GetY()), band.y_last);
+	Point span_top_left(std::max(top_left.GetX(), band.x_first), y_first);
+	Point span_bottom_right(std::min(bottom_right.GetX(), band.x_last), y_last);
+	int64_t fixed_xoffset = (int64_t) xoffset * 65536;
+	std::vector<ActiveEdge>& active_edges = band.active_edges;
+
+	active_edges.clear();
+	unsigned int next_edge = 0;
+	for (int y = y_first; y <= y_last; y++) {
+		/* Insert the edges starting at this scanline, keeping the list sorted by x */
+		while (next_edge < edge_count && edges[next_edge].y_top + yoffset <= y) {
+			const Edge& edge = edges[next_edge++];
+			if (edge.y_bottom + yoffset > y) {
+				ActiveEdge active;
+				active.x = edge.x + fixed_xoffset + (int64_t) (y - edge.y_top - yoffset) * edge.dx;
+				active.dx = edge.dx;
+				active.y_bottom = edge.y_bottom + yoffset;
+				active_edges.push_back(active);
+				for (int j = active_edges.size() - 1; j > 0 && active_edges[j - 1].x > active_edges[j].x; j--) {
+					std::swap(active_edges[j - 1], active_edges[j]);
+				}
+			}
 		}
-	} else if (abs(end.GetY() - start.GetY()) < abs(end.GetX() - start.GetX())) {
-		if (start.GetX() > end.GetX()) {
-			SetRasteredPolygonIntersectionsLow(end, start, intersections, ymin);
-		} else {
-			SetRasteredPolygonIntersectionsLow(start, end, intersections, ymin);
+
+		/* Fill between pairs of crossings, leaving the crossings to the outline */
+		for (unsigned int j = 0; j + 1 < active_edges.size(); j += 2) {
+			int x0 = (active_edges[j].x >> 16) + 1;
+			int x1 = ((active_edges[j + 1].x + 65535) >> 16) - 1;
+			if (x0 <= x1) {
+				RasterSpan<Format>(y, x0, x1, pixel, span_top_left, span_bottom_right);
+			}
 		}
-	} else {
-		if (start.GetY() > end.GetY()) {
-			SetRasteredPolygonIntersectionsHigh(end, start, intersections, ymin);
-		} else {
-			SetRasteredPolygonIntersectionsHigh(start, end, intersections, ymin);
+
+		/* Drop finished edges, step the others and restore the x order */
+		unsigned int count = 0;
+		for (unsigned int j = 0; j < active_edges.size(); j++) {
+			if (active_edges[j].y_bottom > y + 1) {
+				active_edges[count] = active_edges[j];
+				active_edges[count].x += active_edges[count].dx;
+				for (int k = count; k > 0 && active_edges[k - 1].x > active_edges[k].x; k--) {
+					std::swap(active_edges[k - 1], active_edges[k]);
+				}
+				count++;
+			}
 		}
+		active_edges.resize(count);
 	}
 }
 
-/* Set the rastered polygon line with low gradient (0 < m < 1 or -1 < m < 0)
-intersections */
-void Framebuffer::SetRasteredPolygonIntersectionsLow(const Point& start, const Point& end, std::vector<std::vector<int>>& intersections, int ymin) {
-	int dx = end.GetX() - start.GetX();
-	int dy = end.GetY() - start.GetY();
+/* Display the framebuffer */
+void Framebuffer::Display() {
+  if (page_flipping_) {
+    int back_page = 1 - front_page_;
+    if (target_->Pan(back_page * height_)) {
+      front_page_ = back_page;
+      buffer_ = address_ + (1 - front_page_) * screen_memory_size_;
+      last_presented_bytes_ = 0;
+      return;
+    }
 
-	int yi;
-	if (dy < 0) {
-		yi = -1;
-		dy = -dy;
-	} else {
-		yi = 1;
-	}
+    /* The target stopped panning, so the back page would never be shown.
+    Go back to copying, which presents this frame in full */
+    SetPageFlipping(false);
+  }
 
-	int p = 2 * dy - dx;
-	int y = start.GetY();
+  if (damage_mode_ == DAMAGE_OFF) {
+    PixelKernels::StreamCopy(address_ + front_page_ * screen_memory_size_, buffer_, screen_memory_size_);
+    last_presented_bytes_ = screen_memory_size_;
+    return;
+  }
 
-	for (int x = start.GetX(); x <= end.GetX(); x++) {
-		if (p > 0) {
-			intersections[y - ymin].push_back(x);
-			y += yi;
-			p -= (2 * dx);
-		}
-		p += (2 * dy);
-	}
+  last_presented_bytes_ = 0;
+  for (int tile_y = 0; tile_y < tiles_y_; tile_y++) {
+    uint8_t *damaged = &damaged_tiles_[tile_y * tiles_x_];
+    if (damage_mode_ == DAMAGE_TILES_HASHED) {
+      for (int tile_x = 0; tile_x < tiles_x_; tile_x++) {
+        if (damaged[tile_x]) {
+          int idx = tile_y * tiles_x_ + tile_x;
+          uint64_t hash = HashTile(tile_x, tile_y);
+          if (tile_hash_valid_[idx] && tile_hashes_[idx] == hash) {
+            damaged[tile_x] = 0;
+          } else {
+            tile_hashes_[idx] = hash;
+            tile_hash_valid_[idx] = 1;
+          }
+        }
+      }
+    }
+
+    /* Copy each run of consecutive damaged tiles with one memcpy per row */
+    int tile_x = 0;
+    while (tile_x < tiles_x_) {
+      if (damaged[tile_x]) {
+        int last_tile_x = tile_x;
+        while (last_tile_x + 1 < tiles_x_ && damaged[last_tile_x + 1]) {
+          last_tile_x++;
+        }
+        last_presented_bytes_ += PresentTiles(tile_y, tile_x, last_tile_x);
+        tile_x = last_tile_x + 1;
+      } else {
+        tile_x++;
+      }
+    }
+  }
+  std::fill(damaged_tiles_.begin(), damaged_tiles_.end(), 0);
 }
 
-/* Set the rastered polygon line with low gradient (0 < m < 1 or -1 < m < 0)
-intersections */
-void Framebuffer::SetRasteredPolygonIntersectionsHigh(const Point& start, const Point& end, std::vector<std::vector<int>>& intersections, int ymin) {
-	int dx = end.GetX() - start.GetX();
-	int dy = end.GetY() - start.GetY();
+/* Copy a run of tiles in one tile row from the buffer to the screen, returns the copied bytes */
+long Framebuffer::PresentTiles(int tile_y, int first_tile_x, int last_tile_x) {
+  int y0 = tile_y * DAMAGE_TILE_SIZE;
+  int y1 = std::min<long>(y0 + DAMAGE_TILE_SIZE, height_);
+  int x0 = first_tile_x * DAMAGE_TILE_SIZE;
+  int x1 = std::min<long>((last_tile_x + 1) * DAMAGE_TILE_SIZE, width_);
+  long offset = y0 * line_length_ + x0 * bytes_per_pixel_;
+  long row_size = (x1 - x0) * bytes_per_pixel_;
+  uint8_t *screen = address_ + front_page_ * screen_memory_size_;
+  for (int y = y0; y < y1; y++) {
+    PixelKernels::StreamCopy(screen + offset, buffer_ + offset, row_size);
+    offset += line_length_;
+  }
+  return row_size * (y1 - y0);
+}
 
-	int xi;
-	if (dx < 0) {
-		xi = -1;
-		dx = -dx;
-	} else {
-		xi = 1;
-	}
-	int p = 2 * dx - dy;
-	int x = start.GetX();
+/* Hash the content of a tile in the buffer */
+uint64_t Framebuffer::HashTile(int tile_x, int tile_y) const {
+  int y0 = tile_y * DAMAGE_TILE_SIZE;
+  int y1 = std::min<long>(y0 + DAMAGE_TILE_SIZE, height_);
+  int x0 = tile_x * DAMAGE_TILE_SIZE;
+  int x1 = std::min<long>(x0 + DAMAGE_TILE_SIZE, width_);
+  long row_size = (x1 - x0) * bytes_per_pixel_;
+
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  for (int y = y0; y < y1; y++) {
+    const uint8_t *row = buffer_ + y * line_length_ + x0 * bytes_per_pixel_;
+    long i = 0;
+    for (; i + 8 <= row_size; i += 8) {
+      uint64_t word;
+      memcpy(&word, row + i, sizeof(word));
+      hash = (hash ^ word) * 0x100000001b3ULL;
+      hash ^= hash >> 29;
+    }
+    for (; i < row_size; i++) {
+      hash = (hash ^ row[i]) * 0x100000001b3ULL;
+    }
+  }
+  return hash;
+}
 
-	for (int y = start.GetY(); y <= end.GetY(); y++) {
-		intersections[y - ymin].push_back(x);
-		if (p > 0) {
-			x += xi;
-			p -= (2 * dy);
-		}
-		p += (2 * dx);
-	}
+/* Mark the tiles covered by the rectangle (x0, y0) - (x1, y1) as damaged */
+void Framebuffer::MarkDamaged(int x0, int y0, int x1, int y1) {
+  x0 = std::max(x0, 0);
+  y0 = std::max(y0, 0);
+  x1 = std::min<long>(x1, width_ - 1);
+  y1 = std::min<long>(y1, height_ - 1);
+  if (x0 > x1 || y0 > y1) {
+    return;
+  }
+  for (int tile_y = y0 / DAMAGE_TILE_SIZE; tile_y <= y1 / DAMAGE_TILE_SIZE; tile_y++) {
+    uint8_t *damaged = &damaged_tiles_[tile_y * tiles_x_];
+    for (int tile_x = x0 / DAMAGE_TILE_SIZE; tile_x <= x1 / DAMAGE_TILE_SIZE; tile_x++) {
+      damaged[tile_x] = 1;
+    }
+  }
 }
 
-/* Display the framebuffer */
-void Framebuffer::Display() {
-  memcpy(address_, buffer_, screen_memory_size_);
+/* Fill the rectangle from top_left to bottom_right (inclusive) with the specified color */
+void Framebuffer::FillRect(const Point& top_left, const Point& bottom_right, const Color& color) {
+  int x0 = std::max(top_left.GetX(), 0);
+  int y0 = std::max(top_left.GetY(), 0);
+  int x1 = std::min<long>(bottom_right.GetX(), width_ - 1);
+  int y1 = std::min<long>(bottom_right.GetY(), height_ - 1);
+  if (x0 > x1 || y0 > y1) {
+    return;
+  }
+  MarkDamaged(x0, y0, x1, y1);
+
+  FillJob job;
+  job.pixel = PackColor(color);
+  job.streaming = page_flipping_ || (long) (x1 - x0 + 1) * (y1 - y0 + 1) * bytes_per_pixel_ > STREAMING_FILL_BYTES;
+  RunBanded(x0, y0, x1, y1, raster_.fill_rect_band, &job);
+}
+
+/* Fill a whole band with the pixel of a FillJob */
+template <class Format>
+void Framebuffer::FillRectBand(RasterBand& band, const void *job) {
+  const FillJob& fill = *(const FillJob*) job;
+  long count = band.x_last - band.x_first + 1;
+  if (!IsOpaqueWrite(fill.pixel)) {
+    for (int y = band.y_first; y <= band.y_last; y++) {
+      Format::Blend(buffer_ + y * line_length_ + band.x_first * Format::BYTES, fill.pixel, count);
+    }
+  } else if (count == width_ && line_length_ == width_ * Format::BYTES) {
+    /* Whole rows without padding are one contiguous run */
+    Format::Fill(buffer_ + band.y_first * line_length_, fill.pixel, count * (band.y_last - band.y_first + 1), fill.streaming);
+  } else {
+    for (int y = band.y_first; y <= band.y_last; y++) {
+      Format::Fill(buffer_ + y * line_length_ + band.x_first * Format::BYTES, fill.pixel, count, fill.streaming);
+    }
+  }
+}
+
+/* Blend the pixels of a layer over the buffer, with the top left corner of
+the layer at (xoffset, yoffset) */
+void Framebuffer::CompositeLayer(const Layer& layer, int xoffset, int yoffset) {
+  const Framebuffer& source = layer.GetFramebuffer();
+  int x0 = std::max(xoffset, 0);
+  int y0 = std::max(yoffset, 0);
+  int x1 = std::min<long>(xoffset + source.width_ - 1, width_ - 1);
+  int y1 = std::min<long>(yoffset + source.height_ - 1, height_ - 1);
+  if (x0 > x1 || y0 > y1) {
+    return;
+  }
+  MarkDamaged(x0, y0, x1, y1);
+
+  CompositeJob job;
+  job.pixels = source.buffer_;
+  job.line_length = source.line_length_;
+  job.xoffset = xoffset;
+  job.yoffset = yoffset;
+  RunBanded(x0, y0, x1, y1, raster_.composite_band, &job);
+}
+
+/* Blend the rows of a layer that fall in a band */
+template <class Format>
+void Framebuffer::CompositeBand(RasterBand& band, const void *job) {
+  const CompositeJob& composite = *(const CompositeJob*) job;
+  long count = band.x_last - band.x_first + 1;
+  for (int y = band.y_first; y <= band.y_last; y++) {
+    Format::Composite(buffer_ + y * line_length_ + band.x_first * Format::BYTES,
+                      composite.pixels + (y - composite.yoffset) * composite.line_length + (band.x_first - composite.xoffset) * 4, count);
+  }
+}
+
+/* Blend a layer, scaled with nearest neighbour sampling, over a rectangle */
+void Framebuffer::CompositeLayer(const Layer& layer, const Point& top_left, const Point& bottom_right, int32_t u_first, int32_t v_first, int32_t u_step, int32_t v_step) {
+  const Framebuffer& source = layer.GetFramebuffer();
+  int x0 = std::max(top_left.GetX(), 0);
+  int y0 = std::max(top_left.GetY(), 0);
+  int x1 = std::min<long>(bottom_right.GetX(), width_ - 1);
+  int y1 = std::min<long>(bottom_right.GetY(), height_ - 1);
+  if (x0 > x1 || y0 > y1) {
+    return;
+  }
+  MarkDamaged(x0, y0, x1, y1);
+
+  ScaledCompositeJob job;
+  job.pixels = source.buffer_;
+  job.line_length = source.line_length_;
+  job.x_first = top_left.GetX();
+  job.y_first = top_left.GetY();
+  job.u_first = u_first;
+  job.v_first = v_first;
+  job.u_step = u_step;
+  job.v_step = v_step;
+  RunBanded(x0, y0, x1, y1, raster_.scaled_composite_band, &job);
+}
+
+/* Blend the sampled rows of a layer that fall in a band */
+template <class Format>
+void Framebuffer::ScaledCompositeBand(RasterBand& band, const void *job) {
+  const ScaledCompositeJob& composite = *(const ScaledCompositeJob*) job;
+  long count = band.x_last - band.x_first + 1;
+  int32_t u = composite.u_first + (band.x_first - composite.x_first) * composite.u_step;
+
+  /* Unscaled columns are blended straight from the layer, scaled ones are
+  gathered through a table of the sampled columns, the same for every row */
+  bool is_copy = composite.u_step == 65536;
+  if (!is_copy) {
+    band.samples.resize(count);
+    band.sample_columns.resize(count);
+    for (long i = 0; i < count; i++) {
+      band.sample_columns[i] = ((u + i * composite.u_step) >> 16) * 4;
+    }
+  }
+  for (int y = band.y_first; y <= band.y_last; y++) {
+    int32_t v = composite.v_first + (y - composite.y_first) * composite.v_step;
+    const uint8_t *row = composite.pixels + (v >> 16) * composite.line_length;
+    const uint8_t *src = row + (u >> 16) * 4;
+    if (!is_copy) {
+      const int *columns = band.sample_columns.data();
+      uint32_t *samples = band.samples.data();
+      for (long i = 0; i < count; i++) {
+        memcpy(&samples[i], row + columns[i], 4);
+      }
+      src = (const uint8_t*) samples;
+    }
+    Format::Composite(buffer_ + y * line_length_ + band.x_first * Format::BYTES, src, count);
+  }
 }
 
 /* Clear the framebuffer (Set all pixel to black )*/
 void Framebuffer::Clear() {
-  for (int y = 0; y < GetHeight(); y++) {
-    for (int x = 0; x < GetWidth(); x++) {
-      SetPixel(Point(x, y), COLOR_BLACK);
+  FillRect(Point(0, 0), Point(width_ - 1, height_ - 1), COLOR_BLACK);
+}
+
+/* Save the last displayed frame as a PPM image */
+bool Framebuffer::SaveAsPPM(const char *file_path) const {
+  return target_->SaveAsPPM(file_path);
+}
+
+/* Set how Display() tracks damaged regions (default is DAMAGE_TILES) */
+void Framebuffer::SetDamageMode(DamageMode mode) {
+  damage_mode_ = mode;
+  std::fill(damaged_tiles_.begin(), damaged_tiles_.end(), 1);
+  std::fill(tile_hash_valid_.begin(), tile_hash_valid_.end(), 0);
+}
+
+/* Render straight into the hidden half of a double height screen and pan to
+it on Display() instead of copying */
+bool Framebuffer::SetPageFlipping(bool enabled) {
+  if (enabled == page_flipping_) {
+    return true;
+  }
+
+  if (enabled) {
+    if (target_->GetVirtualHeight() < 2 * height_ || !target_->Pan(0)) {
+      return false;
     }
+    front_page_ = 0;
+    buffer_ = address_ + screen_memory_size_;
+    memcpy(buffer_, heap_buffer_, screen_memory_size_);
+  } else {
+    memcpy(heap_buffer_, buffer_, screen_memory_size_);
+    /* Frames are copied to the first page again, or to the page on screen
+    if the target cannot pan back */
+    if (front_page_ != 0) {
+      memcpy(address_, address_ + front_page_ * screen_memory_size_, screen_memory_size_);
+      if (target_->Pan(0)) {
+        front_page_ = 0;
+      }
+    }
+    buffer_ = heap_buffer_;
+  }
+  page_flipping_ = enabled;
+  SetDamageMode(damage_mode_);
+  return true;
+}
+
+/* Set how draw calls combine colors with the buffer (default is BLEND_ALPHA) */
+void Framebuffer::SetBlendMode(BlendMode mode) {
+  blend_mode_ = mode;
+}
+
+/* Split sprites and large fills into horizontal bands and rasterize them on
+count threads, including the calling one (1 turns banding off) */
+void Framebuffer::SetRasterThreads(int count) {
+  count = std::max(count, 1);
+  if (count == raster_threads_) {
+    return;
   }
+  delete raster_pool_;
+  raster_pool_ = count > 1 ? new ThreadPool(count - 1) : 0;
+  raster_threads_ = count;
 }
 
 /* Getter */
 long Framebuffer::GetHeight() const {
-	return vinfo_.yres;
+	return height_;
 }
 
 long Framebuffer::GetWidth() const {
-	return vinfo_.xres;
+	return width_;
 }
 
-Color Framebuffer::GetPixelColor(const Point& position) const {
-	Color color(0, 0, 0);
-	if (position.GetX() >= 0 && (unsigned int) position.GetX() < vinfo_.xres && position.GetY() >= 0 && (unsigned int) position.GetY() < vinfo_.yres) {
-		long address_offset = position.GetX() * (vinfo_.bits_per_pixel/8) + position.GetY() * finfo_.line_length;
-		color.SetB(buffer_[address_offset]);
-		color.SetG(buffer_[address_offset + 1]);
-		color.SetR(buffer_[address_offset + 2]);
-	}
-	return color;
+DamageMode Framebuffer::GetDamageMode() const {
+	return damage_mode_;
 }
 
-/* Compute the bit code for a point (x, y) using the clip rectangle */
-int Framebuffer::ComputeOutCode(const Point& p, const Point& top_left, const Point& bottom_right) {
-	int code = INSIDE;
+bool Framebuffer::IsPageFlipping() const {
+	return page_flipping_;
+}
 
-	if (p.GetX() < top_left.GetX()) {
-		code |= LEFT;
-	} else if (p.GetX() > bottom_right.GetX()) {
-		code |= RIGHT;
-	}
-	if (p.GetY() < top_left.GetY()) {
-		code |= TOP;
-	} else if (p.GetY() > bottom_right.GetY()) {
-		code |= BOTTOM;
+long Framebuffer::GetLastPresentedBytes() const {
+	return last_presented_bytes_;
+}
+
+int Framebuffer::GetRasterThreads() const {
+	return raster_threads_;
+}
+
+BlendMode Framebuffer::GetBlendMode() const {
+	return blend_mode_;
+}
+
+Color Framebuffer::GetPixelColor(const Point& position) const {
+	if (!IsInsideScreen(position.GetX(), position.GetY())) {
+		return COLOR_BLACK;
 	}
+	return raster_.unpack_color(buffer_ + position.GetY() * line_length_ + position.GetX() * bytes_per_pixel_);
+}
+
+Color Framebuffer::GetScreenColor(const Color& color) const {
+	uint8_t pixel[4];
+	uint32_t value = PackColor(color);
+	memcpy(pixel, &value, sizeof(pixel));
+	return raster_.unpack_color(pixel);
+}
 
-	return code;
+int Framebuffer::GetBitsPerPixel() const {
+	return bytes_per_pixel_ * 8;
 }
 
-/* Cohen–Sutherland clipping algorithm clips a line from p1 = (x1, y1) to p2 = (x2, y2) against a rectangle */
+/* Draw the part of the line from p1 to p2 inside a rectangle (Liang–Barsky clipping) */
 void Framebuffer::ClipLine(const Point& p1, const Point& p2, const Point& top_left, const Point& bottom_right, Color color) {
-	int outcode1 = ComputeOutCode(p1, top_left, bottom_right);
-	int outcode2 = ComputeOutCode(p2, top_left, bottom_right);
-
-	bool accept = false;
-	Point clipped_p1 = p1;
-	Point clipped_p2 = p2;
-	Point p;
-	int outcode_out;
-
-	while(true) {
-		if (!(outcode1 | outcode2)) {
-			accept = 1;
-			break;
-		} else if (outcode1 & outcode2) {
-			break;
-		} else {
-			outcode_out = outcode1 ? outcode1 : outcode2;
-
-			if (outcode_out & BOTTOM) {
-				p.SetX(clipped_p1.GetX() + (clipped_p2.GetX() - clipped_p1.GetX()) * (bottom_right.GetY() - clipped_p1.GetY()) / (clipped_p2.GetY() - clipped_p1.GetY()));
-				p.SetY(bottom_right.GetY());
-			} else if (outcode_out & TOP) {
-				p.SetX(clipped_p1.GetX() + (clipped_p2.GetX() - clipped_p1.GetX()) * (top_left.GetY() - clipped_p1.GetY()) / (clipped_p2.GetY() - clipped_p1.GetY()));
-				p.SetY(top_left.GetY());
-			} else if (outcode_out & RIGHT) {
-				p.SetY(clipped_p1.GetY() + (clipped_p2.GetY() - clipped_p1.GetY()) * (bottom_right.GetX() - clipped_p1.GetX()) / (clipped_p2.GetX() - clipped_p1.GetX()));
-				p.SetX(bottom_right.GetX());
-			} else if (outcode_out & LEFT) {
-				p.SetY(clipped_p1.GetY() + (clipped_p2.GetY() - clipped_p1.GetY()) * (top_left.GetX() - clipped_p1.GetX()) / (clipped_p2.GetX() - clipped_p1.GetX()));
-				p.SetX(top_left.GetX());
-			}
+	ClipLines(&p1, &p2, 1, top_left, bottom_right, color);
+}
 
-			if (outcode_out == outcode1) {
-				clipped_p1 = p;
-				outcode1 = ComputeOutCode(clipped_p1, top_left, bottom_right);
-			} else {
-				clipped_p2 = p;
-				outcode2 = ComputeOutCode(clipped_p2, top_left, bottom_right);
-			}
-		}
+/* Draw the parts of count lines, from starts[i] to ends[i], inside a rectangle */
+void Framebuffer::ClipLines(const Point *starts, const Point *ends, int count, const Point& top_left, const Point& bottom_right, const Color& color) {
+	RasterBand& band = GetScreenBand();
+	PixelSegments& segments = band.pixel_segments;
+	segments.Reserve(count);
+	for (int i = 0; i < count; i++) {
+		segments.x0[i] = starts[i].GetX();
+		segments.y0[i] = starts[i].GetY();
+		segments.x1[i] = ends[i].GetX();
+		segments.y1[i] = ends[i].GetY();
 	}
-
-	if (accept) {
-		DrawLine(clipped_p1, clipped_p2, color);
+	int left = LineClipper::Clip(segments, count, top_left, bottom_right);
+
+	uint32_t pixel = PackColor(color);
+	for (int i = 0; i < left; i++) {
+		Point start(segments.x0[i], segments.y0[i]);
+		Point end(segments.x1[i], segments.y1[i]);
+		MarkDamaged(std::min(start.GetX(), end.GetX()), std::min(start.GetY(), end.GetY()),
+		            std::max(start.GetX(), end.GetX()), std::max(start.GetY(), end.GetY()));
+		(this->*raster_.raster_line)(start, end, pixel, band);
 	}
 }
 
@@ -561,16 +1031,23 @@ void Framebuffer::ClipLine(const Point& p1, const Point& p2, const Point& top_le
 
 /* Draw a circle with specified color from the specified center and radius in the framebuffer using midpoint circle algorithm */
 void Framebuffer::DrawCircle(const Point& center, int radius, const Color& color) {
+	MarkDamaged(center.GetX() - radius, center.GetY() - radius, center.GetX() + radius, center.GetY() + radius);
+	(this->*raster_.raster_circle)(center, radius, PackColor(color), GetScreenBand());
+}
+
+/* Draw the part of a circle outline inside a band, without marking it as damaged */
+template <class Format>
+void Framebuffer::RasterCircle(const Point& center, int radius, uint32_t pixel, const RasterBand& band) {
     // When radius is zero only a single
     // point will be printed
     if (radius > 0)
     {
 			int x = radius, y = 0;
 
-			SetPixel(Point(x + center.GetX(), y + center.GetY()), color);
-			SetPixel(Point(-x + center.GetX(), y + center.GetY()), color);
-			SetPixel(Point(y + center.GetX(), x + center.GetY()), color);
-			SetPixel(Point(y + center.GetX(), -x + center.GetY()), color);
+			PutPixel<Format>(x + center.GetX(), y + center.GetY(), pixel, band);
+			PutPixel<Format>(-x + center.GetX(), y + center.GetY(), pixel, band);
+			PutPixel<Format>(y + center.GetX(), x + center.GetY(), pixel, band);
+			PutPixel<Format>(y + center.GetX(), -x + center.GetY(), pixel, band);
 
 			// Initialising the value of P
 			int P = 1 - radius;
@@ -592,83 +1069,332 @@ void Framebuffer::DrawCircle(const Point& center, int radius, const Color& color
 
 				// Printing the generated point and its reflection
 				// in the other octants after translation
-				SetPixel(Point(x + center.GetX(), y + center.GetY()), color);
-				SetPixel(Point(-x + center.GetX(), y + center.GetY()), color);
-				SetPixel(Point(x + center.GetX(), -y + center.GetY()), color);
-				SetPixel(Point(-x + center.GetX(), -y + center.GetY()), color);
+				PutPixel<Format>(x + center.GetX(), y + center.GetY(), pixel, band);
+				PutPixel<Format>(-x + center.GetX(), y + center.GetY(), pixel, band);
+				PutPixel<Format>(x + center.GetX(), -y + center.GetY(), pixel, band);
+				PutPixel<Format>(-x + center.GetX(), -y + center.GetY(), pixel, band);
 
 				// If the generated point is on the line x = y then
 				// the perimeter points have already been printed
 				if (x != y) {
-					SetPixel(Point(y + center.GetX(), x + center.GetY()), color);
-					SetPixel(Point(-y + center.GetX(), x + center.GetY()), color);
-					SetPixel(Point(y + center.GetX(), -x + center.GetY()), color);
-					SetPixel(Point(-y + center.GetX(), -x + center.GetY()), color);
+					PutPixel<Format>(y + center.GetX(), x + center.GetY(), pixel, band);
+					PutPixel<Format>(-y + center.GetX(), x + center.GetY(), pixel, band);
+					PutPixel<Format>(y + center.GetX(), -x + center.GetY(), pixel, band);
+					PutPixel<Format>(-y + center.GetX(), -x + center.GetY(), pixel, band);
 				}
 			}
     } else {
-			SetPixel(center, color);
+			PutPixel<Format>(center.GetX(), center.GetY(), pixel, band);
 		}
 }
 
 
-  /* Draw a filled circle with specified color from the specified center and radius in the framebuffer using midpoint circle algorithm */
-  void Framebuffer::DrawFilledCircle(const Point& center, int radius, const Color& border_color, const Color& fill_color) {
-		// When radius is zero only a single
-		// point will be printed
-		if (radius > 0)
-		{
-			int x = radius, y = 0;
-
-			DrawLine(Point(x + center.GetX(), y + center.GetY()), Point(-x + center.GetX(), y + center.GetY()), fill_color);
-			DrawLine(Point(y + center.GetX(), x + center.GetY()), Point(y + center.GetX(), -x + center.GetY()), fill_color);
-
-			// Initialising the value of P
-			int P = 1 - radius;
-			while (x > y) {
-				y++;
+/* Draw a filled circle with specified color from the specified center and radius in the framebuffer using midpoint circle algorithm */
+void Framebuffer::DrawFilledCircle(const Point& center, int radius, const Color& border_color, const Color& fill_color) {
+	MarkDamaged(center.GetX() - radius, center.GetY() - radius, center.GetX() + radius, center.GetY() + radius);
+	(this->*raster_.raster_filled_circle)(center, radius, PackColor(border_color), PackColor(fill_color), GetScreenBand());
+}
 
-				// Mid-point is inside or on the perimeter
-				if (P <= 0) {
-					P = P + 2 * y + 1;
-				} else { // Mid-point is outside the perimeter
-					x--;
-					P = P + 2*y - 2*x + 1;
+/* Draw the part of a filled circle inside a band, without marking it as damaged */
+template <class Format>
+void Framebuffer::RasterFilledCircle(const Point& center, int radius, uint32_t border_pixel, uint32_t fill_pixel, const RasterBand& band) {
+	Point band_top_left(band.x_first, band.y_first);
+	Point band_bottom_right(band.x_last, band.y_last);
+	int cx = center.GetX();
+	int cy = center.GetY();
+
+	// When radius is zero only a single
+	// point will be printed
+	if (radius > 0) {
+		int x = radius, y = 0;
+		RasterSpan<Format>(cy, cx - x, cx + x, fill_pixel, band_top_left, band_bottom_right);
+
+		// Rows at distance x are only filled once, with the widest span, right
+		// before x changes (pending_y is the half width of that span). If the
+		// loop ends on x == y, that row is already covered by the y rows
+		int pending_y = 0;
+
+		// Initialising the value of P
+		int P = 1 - radius;
+		while (x > y) {
+			y++;
+
+			// Mid-point is inside or on the perimeter
+			if (P <= 0) {
+				P = P + 2 * y + 1;
+			} else { // Mid-point is outside the perimeter
+				if (pending_y > 0) {
+					RasterSpan<Format>(cy + x, cx - pending_y, cx + pending_y, fill_pixel, band_top_left, band_bottom_right);
+					RasterSpan<Format>(cy - x, cx - pending_y, cx + pending_y, fill_pixel, band_top_left, band_bottom_right);
+					pending_y = 0;
 				}
+				x--;
+				P = P + 2*y - 2*x + 1;
+			}
 
-				// All the perimeter points have already been printed
-				if (x < y) {
-					break;
-				}
+			// All the perimeter points have already been printed
+			if (x < y) {
+				break;
+			}
 
-				// Printing the generated point and its reflection
-				// in the other octants after translation
-				DrawLine(Point(x + center.GetX(), y + center.GetY()), Point(-x + center.GetX(), y + center.GetY()), fill_color);
-				DrawLine(Point(x + center.GetX(), -y + center.GetY()), Point(-x + center.GetX(), -y + center.GetY()), fill_color);
+			// Fill the rows of the generated point and its reflection
+			RasterSpan<Format>(cy + y, cx - x, cx + x, fill_pixel, band_top_left, band_bottom_right);
+			RasterSpan<Format>(cy - y, cx - x, cx + x, fill_pixel, band_top_left, band_bottom_right);
 
-				// If the generated point is on the line x = y then
-				// the perimeter points have already been printed
-				if (x != y) {
-					DrawLine(Point(y + center.GetX(), x + center.GetY()), Point(-y + center.GetX(), x + center.GetY()), fill_color);
-					DrawLine(Point(y + center.GetX(), -x + center.GetY()), Point(-y + center.GetX(), -x + center.GetY()), fill_color);
-				}
+			// If the generated point is on the line x = y then
+			// its rows have already been filled
+			if (x != y) {
+				pending_y = y;
 			}
-		} else {
-			SetPixel(center, fill_color);
 		}
-		DrawCircle(center, radius, border_color);
+	} else {
+		PutPixel<Format>(center.GetX(), center.GetY(), fill_pixel, band);
 	}
+	RasterCircle<Format>(center, radius, border_pixel, band);
+}
 
 /* Draw a sprite to the framebuffer */
 void Framebuffer::DrawSprite(const Sprite& sprite, int xoffset, int yoffset) {
-	for (unsigned i = 0; i < sprite.polygons_.size(); i++) {
-		DrawRasteredPolygon(sprite.polygons_[i], sprite.border_colors_[i], sprite.fill_colors_[i], Point(0, 0), Point(GetWidth() - 1, GetHeight() - 1), xoffset, yoffset);
-	}
+	DrawClippedSprite(sprite, Point(0, 0), Point(width_ - 1, height_ - 1), xoffset, yoffset);
 }
 
 /* Draw a sprite (clipped) to the framebuffer */
 void Framebuffer::DrawClippedSprite(const Sprite& sprite, const Point& top_left, const Point& bottom_right, int xoffset, int yoffset) {
-	for (unsigned i = 0; i < sprite.polygons_.size(); i++) {
-		DrawRasteredPolygon(sprite.polygons_[i], sprite.border_colors_[i], sprite.fill_colors_[i], top_left, bottom_right, xoffset, yoffset);
+	if (sprite.GetBoundingBox().IsOutside(top_left, bottom_right, xoffset, yoffset)) {
+		return;
+	}
+	RasterSprite(sprite, sprite.GetShapes(), 0, sprite.GetPolygonCount(), top_left, bottom_right, xoffset, yoffset);
+}
+
+/* Draw a sprite (clipped) moved by a transform */
+void Framebuffer::DrawClippedSprite(const Sprite& sprite, const Transform2D& transform, const Point& top_left, const Point& bottom_right) {
+	DrawClippedSprite(sprite, NULL, sprite.GetPolygonCount(), transform, top_left, bottom_right);
+}
+
+/* Draw some polygons of a sprite (clipped) moved by a transform */
+void Framebuffer::DrawClippedSprite(const Sprite& sprite, const int *polygons, int count, const Transform2D& transform, const Point& top_left, const Point& bottom_right) {
+	/* Whole pixel moves reuse the cached edge tables of the sprite */
+	if (transform.IsPixelTranslation()) {
+		if (!sprite.GetBoundingBox().IsOutside(top_left, bottom_right, transform.GetXOffset(), transform.GetYOffset())) {
+			RasterSprite(sprite, sprite.GetShapes(), polygons, count, top_left, bottom_right, transform.GetXOffset(), transform.GetYOffset());
+		}
+		return;
 	}
+	if (sprite.GetBoundingBox().Transform(transform).IsOutside(top_left, bottom_right)) {
+		return;
+	}
+
+	TransformShapes(sprite.GetXs(), sprite.GetYs(), sprite.GetPolygons(), sprite.GetBoundingBoxes(), polygons, count, transform, top_left, bottom_right);
+	RasterSprite(sprite, transformed_shapes_.data(), polygons, count, top_left, bottom_right, 0, 0);
+}
+
+/* Mark the damage of the polygons of a sprite and rasterize them, in bands */
+void Framebuffer::RasterSprite(const Sprite& sprite, const PolygonShape *shapes, const int *polygons, int count, const Point& top_left, const Point& bottom_right, int xoffset, int yoffset) {
+	/* Build the edge tables and mark the damage here, so that the bands only
+	read shared state */
+	int y_first = height_;
+	int y_last = -1;
+	std::vector<int>& visible = visible_polygons_;
+	visible.clear();
+	for (int k = 0; k < count; k++) {
+		int i = polygons ? polygons[k] : k;
+		int x0 = std::max(shapes[i].x_min + xoffset, top_left.GetX());
+		int y0 = std::max(shapes[i].y_min + yoffset, top_left.GetY());
+		int x1 = std::min(shapes[i].x_max + xoffset, bottom_right.GetX());
+		int y1 = std::min(shapes[i].y_max + yoffset, bottom_right.GetY());
+		if (x0 <= x1 && y0 <= y1) {
+			MarkDamaged(x0, y0, x1, y1);
+			y_first = std::min(y_first, y0);
+			y_last = std::max(y_last, y1);
+			visible.push_back(i);
+		}
+	}
+	if (visible.empty()) {
+		return;
+	}
+
+	SpriteJob job;
+	job.sprite = &sprite;
+	job.shapes = shapes;
+	job.visible = visible.data();
+	job.visible_count = visible.size();
+	job.top_left = top_left;
+	job.bottom_right = bottom_right;
+	job.xoffset = xoffset;
+	job.yoffset = yoffset;
+	RunBanded(0, y_first, width_ - 1, y_last, raster_.sprite_band, &job);
+}
+
+/* Transform the points of count polygons into the transformed_ scratch
+space and build their edge tables */
+void Framebuffer::TransformShapes(const Coord *xs, const Coord *ys, const SpritePolygon *polygons, const BoundingBox *boxes, const int *indices, int count, const Transform2D& transform, const Point& top_left, const Point& bottom_right) {
+	if (count == 0) {
+		return;
+	}
+
+	/* Scratch space is laid out like the source, indices are ascending so the
+	last polygon ends the furthest */
+	int last = indices ? indices[count - 1] : count - 1;
+	int point_count = polygons[last].first_point + polygons[last].point_count;
+	transformed_xs_.resize(point_count);
+	transformed_ys_.resize(point_count);
+	if ((int) transformed_tables_.size() < last + 1) {
+		transformed_tables_.resize(last + 1);
+	}
+	transformed_shapes_.resize(last + 1);
+
+	/* Every point in one pass, or the points of the listed polygons only */
+	if (!indices) {
+		transform.Apply(xs, ys, point_count, transformed_xs_.data(), transformed_ys_.data());
+	}
+	for (int k = 0; k < count; k++) {
+		int i = indices ? indices[k] : k;
+		int first_point = polygons[i].first_point;
+		int polygon_point_count = polygons[i].point_count;
+
+		/* Polygons whose moved box is outside the clip rectangle are culled
+		before their edges are built */
+		if (boxes && boxes[i].Transform(transform).IsOutside(top_left, bottom_right)) {
+			polygon_point_count = 0;
+		} else if (indices) {
+			transform.Apply(xs + first_point, ys + first_point, polygon_point_count, transformed_xs_.data() + first_point, transformed_ys_.data() + first_point);
+		}
+		const Coord *polygon_xs = transformed_xs_.data() + first_point;
+		const Coord *polygon_ys = transformed_ys_.data() + first_point;
+		transformed_tables_[i].Build(polygon_xs, polygon_ys, polygon_point_count);
+		transformed_shapes_[i] = Polygon::MakeShape(polygon_xs, polygon_ys, polygon_point_count, transformed_tables_[i]);
+	}
+}
+
+/* Rasterize every polygon of a SpriteJob, in order, inside a band */
+template <class Format>
+void Framebuffer::RasterSpriteBand(RasterBand& band, const void *job) {
+	const SpriteJob& draw = *(const SpriteJob*) job;
+	const Sprite& sprite = *draw.sprite;
+	for (int i = 0; i < draw.visible_count; i++) {
+		const SpritePolygon& polygon = sprite.GetPolygon(draw.visible[i]);
+		RasterPolygon<Format>(draw.shapes[draw.visible[i]], Format::Pack(polygon.border_color), Format::Pack(polygon.fill_color), draw.top_left, draw.bottom_right, draw.xoffset, draw.yoffset, band);
+	}
+}
+
+/* Run the commands of a command buffer, in order */
+void Framebuffer::Execute(const CommandBuffer& commands) {
+	Execute(commands, Point(0, 0), Point(width_ - 1, height_ - 1));
+}
+
+/* Run the part of the commands that falls inside the rectangle from top_left
+to bottom_right */
+void Framebuffer::Execute(const CommandBuffer& commands, const Point& top_left, const Point& bottom_right) {
+	int y_first = height_;
+	int y_last = -1;
+	for (int i = 0; i < commands.GetCommandCount(); i++) {
+		const DrawCommand& command = commands.GetCommand(i);
+		int x0 = std::max(command.x_min, top_left.GetX());
+		int y0 = std::max(command.y_min, top_left.GetY());
+		int x1 = std::min(command.x_max, bottom_right.GetX());
+		int y1 = std::min(command.y_max, bottom_right.GetY());
+		MarkDamaged(x0, y0, x1, y1);
+		if (x0 <= x1 && y0 <= y1) {
+			y_first = std::min(y_first, y0);
+			y_last = std::max(y_last, y1);
+		}
+	}
+
+	ExecuteJob job;
+	job.commands = &commands;
+	RunBanded(top_left.GetX(), y_first, bottom_right.GetX(), y_last, raster_.execute_band, &job);
+}
+
+/* Run every command of an ExecuteJob, in order, inside a band */
+template <class Format>
+void Framebuffer::ExecuteBand(RasterBand& band, const void *job) {
+	const CommandBuffer& commands = *((const ExecuteJob*) job)->commands;
+	for (int i = 0; i < commands.GetCommandCount(); i++) {
+		const DrawCommand& command = commands.GetCommand(i);
+		if (command.y_max < band.y_first || command.y_min > band.y_last || command.x_max < band.x_first || command.x_min > band.x_last) {
+			continue;
+		}
+		switch (command.type) {
+			case COMMAND_POLYGON:
+				RasterPolygon<Format>(command.shape, Format::Pack(command.border_color), Format::Pack(command.fill_color), command.top_left, command.bottom_right, command.xoffset, command.yoffset, band);
+				break;
+			case COMMAND_LINE: {
+				Point clipped_start, clipped_end;
+				Point start = Point::FromCoord(command.shape.xs[0], command.shape.ys[0]);
+				Point end = Point::FromCoord(command.shape.xs[1], command.shape.ys[1]);
+				if (LineClipper::Clip(start, end, command.top_left, command.bottom_right, clipped_start, clipped_end)) {
+					RasterLine<Format>(clipped_start, clipped_end, Format::Pack(command.border_color), band);
+				}
+				break;
+			}
+			case COMMAND_FILLED_CIRCLE:
+				RasterFilledCircle<Format>(Point::FromCoord(command.shape.xs[0], command.shape.ys[0]), command.radius, Format::Pack(command.border_color), Format::Pack(command.fill_color), band);
+				break;
+		}
+	}
+}
+
+/* Split the rows of the rectangle (x_first, y_first) - (x_last, y_last) into
+bands and run task on each of them, on the raster threads if there are more
+than one. Returns when all are done */
+void Framebuffer::RunBanded(int x_first, int y_first, int x_last, int y_last, BandTask task, const void *job) {
+	x_first = std::max(x_first, 0);
+	y_first = std::max(y_first, 0);
+	x_last = std::min<long>(x_last, width_ - 1);
+	y_last = std::min<long>(y_last, height_ - 1);
+	if (x_first > x_last || y_first > y_last) {
+		return;
+	}
+
+	/* Band starts fall on cache line boundaries of the buffer, so two threads
+	never write to the same line */
+	int row_alignment = 1;
+	while ((long) row_alignment * line_length_ % CACHE_LINE_SIZE != 0 && row_alignment < CACHE_LINE_SIZE) {
+		row_alignment++;
+	}
+	int rows = y_last - y_first + 1;
+	int band_count = raster_pool_ ? std::min(raster_threads_ * BANDS_PER_RASTER_THREAD, rows / MIN_BAND_ROWS) : 1;
+	int band_rows = band_count > 1 ? (rows + band_count - 1) / band_count : rows;
+
+	band_count_ = 0;
+	int y = y_first;
+	while (y <= y_last) {
+		int next_y = y + band_rows;
+		next_y = (next_y + row_alignment - 1) / row_alignment * row_alignment;
+		if ((unsigned) band_count_ == bands_.size()) {
+			bands_.resize(band_count_ + 1);
+		}
+		RasterBand& band = bands_[band_count_++];
+		band.x_first = x_first;
+		band.x_last = x_last;
+		band.y_first = y;
+		band.y_last = std::min(next_y - 1, y_last);
+		y = next_y;
+	}
+
+	band_task_ = task;
+	band_job_ = job;
+	if (raster_pool_ && band_count_ > 1) {
+		raster_pool_->Run(&Framebuffer::RunBandTask, this, band_count_);
+	} else {
+		for (int i = 0; i < band_count_; i++) {
+			(this->*task)(bands_[i], job);
+		}
+	}
+}
+
+/* Thread pool entry point of RunBanded */
+void Framebuffer::RunBandTask(void *context, int index) {
+	Framebuffer *framebuffer = (Framebuffer*) context;
+	(framebuffer->*framebuffer->band_task_)(framebuffer->bands_[index], framebuffer->band_job_);
+}
+
+/* A band covering the whole screen, for single threaded drawing */
+RasterBand& Framebuffer::GetScreenBand() {
+	RasterBand& band = bands_[0];
+	band.x_first = 0;
+	band.x_last = width_ - 1;
+	band.y_first = 0;
+	band.y_last = height_ - 1;
+	return band;
 }
@@ -1,24 +1,71 @@
 #ifndef FRAMEBUFFER_H
 #define FRAMEBUFFER_H
 
-#define INSIDE 0
-#define LEFT 1
-#define RIGHT 2
-#define BOTTOM 4
-#define TOP 8
+#define DAMAGE_TILE_SIZE 64
+
+/* Fills larger than this bypass the cache with non-temporal stores */
+#define STREAMING_FILL_BYTES (1 << 20)
+
+/* Banded rasterization: bands handed out per raster thread (so faster threads
+can take more of them) and the fewest rows worth giving to a thread */
+#define BANDS_PER_RASTER_THREAD 4
+#define MIN_BAND_ROWS 16
+
+/* Buffer and band starts are aligned to this, so that no cache line holds
+pixels of two bands */
+#define CACHE_LINE_SIZE 64
+
+/* How Display() decides which part of the buffer to copy to the screen */
+enum DamageMode {
+  DAMAGE_OFF,          /* copy the whole screen every frame */
+  DAMAGE_TILES,        /* copy only the tiles that were drawn to */
+  DAMAGE_TILES_HASHED  /* like DAMAGE_TILES, but skip tiles whose content did not change since the last frame */
+};
+
+/* How draw calls combine colors with what is already in the buffer */
+enum BlendMode {
+  BLEND_REPLACE, /* write the color and its alpha as they are */
+  BLEND_ALPHA    /* blend translucent colors over the buffer by their alpha (opaque colors are written as they are) */
+};
 
-#include <linux/fb.h>
 #include <stdint.h>
 #include <vector>
 #include "point.h"
 #include "polygon.h"
 #include "sprite.h"
+#include "transform.h"
 #include "color.h"
+#include "render_target.h"
+#include "pixel_format.h"
+#include "command_buffer.h"
+#include "line_clipper.h"
+#include "../utils/thread_pool.h"
+
+/* Rectangle (x_first, y_first) - (x_last, y_last) of the screen that one raster
+task may write to */
+struct RasterBand {
+  int x_first;
+  int y_first;
+  int x_last;
+  int y_last;
+  std::vector<ActiveEdge> active_edges; /* scratch space of FillEdgeTable, kept to avoid allocations */
+  PixelSegments pixel_segments; /* scratch space of the batch line clipper */
+  CoordSegments coord_segments;
+  std::vector<uint32_t> samples; /* scratch space of scaled layer compositing */
+  std::vector<int> sample_columns;
+  char padding[CACHE_LINE_SIZE]; /* keeps the scratch space of different threads on separate cache lines */
+};
+
+class Layer;
 
 class Framebuffer {
 public:
-  /* Constructor */
-  Framebuffer(const char *device_path);
+  /* Constructor (asks the device for bits_per_pixel, 16, 24 or 32, and for a
+  second page to flip to if two_pages is set, see SetPageFlipping) */
+  Framebuffer(const char *device_path, int bits_per_pixel = 32, bool two_pages = false);
+
+  /* Constructor (render into the given target, the framebuffer takes ownership) */
+  Framebuffer(RenderTarget *target);
 
   /* Destructor */
   ~Framebuffer();
@@ -26,6 +73,18 @@ public:
   /* Set a pixel with specified color to the specified point in framebuffer */
   void SetPixel(const Point& position, const Color& color);
 
+  /* Fill the pixels from x0 to x1 (inclusive) of row y with the specified
+  color, clipped to the screen */
+  void FillSpan(int y, int x0, int x1, const Color& color);
+
+  /* Fill length pixels of row y starting at x with a device pixel value
+  (PackColor). The span must already be clipped to the screen: nothing is
+  bounds checked or marked as damaged */
+  void WriteSpan(int x, int y, int length, uint32_t pixel);
+
+  /* Device pixel value of a color in the pixel format of the screen */
+  uint32_t PackColor(const Color& color) const;
+
   /* Draw a line with specified color from the specified start and end point
   in the framebuffer */
   void DrawLine(const Point& start, const Point& end, const Color& color);
@@ -46,63 +105,319 @@ public:
   /* Draw a rastered polygon to the framebuffer */
   void DrawRasteredPolygon(const Polygon& polygon, const Color& border_color, const Color& fill_color, const Point& top_left, const Point& bottom_right, int xoffset = 0, int yoffset = 0);
 
+  /* Draw a rastered polygon moved by a transform, applied while its edges
+  are built, without changing or copying the polygon */
+  void DrawRasteredPolygon(const Polygon& polygon, const Transform2D& transform, const Color& border_color, const Color& fill_color, const Point& top_left, const Point& bottom_right);
+
   /* Draw a sprite to the framebuffer */
   void DrawSprite(const Sprite& sprite, int xoffset = 0, int yoffset = 0);
 
   /* Draw a sprite (clipped) to the framebuffer */
   void DrawClippedSprite(const Sprite& sprite, const Point& top_left, const Point& bottom_right, int xoffset = 0, int yoffset = 0);
 
-  /* Cohen–Sutherland clipping algorithm clips a line from p1 = (x1, y1) to p2 = (x2, y2) against a rectangle */
+  /* Draw a sprite (clipped) moved by a transform, applied while its edges
+  are built, without changing or copying the sprite */
+  void DrawClippedSprite(const Sprite& sprite, const Transform2D& transform, const Point& top_left, const Point& bottom_right);
+
+  /* Draw the count polygons of a sprite listed, ascending, in polygons, moved
+  by a transform. Draws the first count polygons when polygons is NULL */
+  void DrawClippedSprite(const Sprite& sprite, const int *polygons, int count, const Transform2D& transform, const Point& top_left, const Point& bottom_right);
+
+  /* Draw the part of the line from p1 to p2 inside a rectangle (Liang–Barsky clipping) */
   void ClipLine(const Point& p1, const Point& p2, const Point& top_left, const Point& bottom_right, Color color);
 
+  /* Draw the parts of count lines, from starts[i] to ends[i], inside a rectangle.
+  The lines are clipped together, several per SIMD instruction */
+  void ClipLines(const Point *starts, const Point *ends, int count, const Point& top_left, const Point& bottom_right, const Color& color);
+
+  /* Run the commands of a command buffer, in order */
+  void Execute(const CommandBuffer& commands);
+
+  /* Run the part of the commands that falls inside the rectangle from top_left
+  to bottom_right, e.g. to redraw a single tile */
+  void Execute(const CommandBuffer& commands, const Point& top_left, const Point& bottom_right);
+
+  /* Blend the pixels of a layer over the buffer, with the top left corner of
+  the layer at (xoffset, yoffset) */
+  void CompositeLayer(const Layer& layer, int xoffset = 0, int yoffset = 0);
+
+  /* Blend a layer, scaled, over the rectangle from top_left to bottom_right.
+  Pixel (x, y) of the rectangle takes the nearest layer pixel
+  (u >> 16, v >> 16), where u = u_first + (x - top_left.x) * u_step and v
+  likewise (16.16 fixed point). Every sampled pixel must be inside the layer */
+  void CompositeLayer(const Layer& layer, const Point& top_left, const Point& bottom_right, int32_t u_first, int32_t v_first, int32_t u_step, int32_t v_step);
+
   /* Display the framebuffer */
   void Display();
 
+  /* Fill the rectangle from top_left to bottom_right (inclusive) with the specified color */
+  void FillRect(const Point& top_left, const Point& bottom_right, const Color& color);
+
   /* Clear the framebuffer (Set all pixel to black )*/
   void Clear();
 
+  /* Save the last displayed frame as a PPM image */
+  bool SaveAsPPM(const char *file_path) const;
+
+  /* Set how Display() tracks damaged regions (default is DAMAGE_TILES) */
+  void SetDamageMode(DamageMode mode);
+
+  /* Render straight into the hidden half of a double height screen and pan to
+  it on Display() instead of copying. Returns false (and keeps copying) if the
+  render target cannot pan. While enabled, the buffer holds the frame before
+  the last one after every Display() and reading pixels reads screen memory.
+  If the target stops panning, Display() turns page flipping off again. */
+  bool SetPageFlipping(bool enabled);
+
+  /* Split sprites and large fills into horizontal bands and rasterize them on
+  count threads, including the calling one (1 turns banding off) */
+  void SetRasterThreads(int count);
+
+  /* Set how draw calls combine colors with the buffer (default is BLEND_ALPHA) */
+  void SetBlendMode(BlendMode mode);
+
   /* Getter */
   long GetHeight() const;
   long GetWidth() const;
   Color GetPixelColor(const Point& position) const;
+  Color GetScreenColor(const Color& color) const; /* color as GetPixelColor reads it back once drawn */
+  int GetBitsPerPixel() const;
+  DamageMode GetDamageMode() const;
+  bool IsPageFlipping() const;
+  long GetLastPresentedBytes() const; /* bytes copied to the screen by the last Display() */
+  int GetRasterThreads() const;
+  BlendMode GetBlendMode() const;
 
 private:
+  /* Work done on one band by RunBanded */
+  typedef void (Framebuffer::*BandTask)(RasterBand& band, const void *job);
+
+  /* Arguments of the band tasks */
+  struct SpriteJob {
+    const Sprite *sprite;
+    const PolygonShape *shapes; /* of every polygon, the sprite's own or transformed ones */
+    const int *visible; /* polygons that reach the clip rectangle, in order */
+    int visible_count;
+    Point top_left;
+    Point bottom_right;
+    int xoffset;
+    int yoffset;
+  };
+
+  struct FillJob {
+    uint32_t pixel;
+    bool streaming;
+  };
+
+  struct ExecuteJob {
+    const CommandBuffer *commands;
+  };
+
+  struct CompositeJob {
+    const uint8_t *pixels; /* ARGB8888 pixels of the layer */
+    int line_length;
+    int xoffset;
+    int yoffset;
+  };
+
+  struct ScaledCompositeJob {
+    const uint8_t *pixels; /* ARGB8888 pixels of the layer */
+    int line_length;
+    int x_first; /* pixel sampled at u_first, v_first */
+    int y_first;
+    int32_t u_first;
+    int32_t v_first;
+    int32_t u_step;
+    int32_t v_step;
+  };
+
+  /* Entry points of the raster code instantiated for the pixel format of the
+  screen, picked once by Init() */
+  struct RasterFunctions {
+    uint32_t (*pack_color)(const Color& color);
+    Color (*unpack_color)(const uint8_t *pixel);
+    void (Framebuffer::*write_span)(int x, int y, int length, uint32_t pixel);
+    void (Framebuffer::*put_pixel)(int x, int y, uint32_t pixel, const RasterBand& band);
+    void (Framebuffer::*raster_span)(int y, int x0, int x1, uint32_t pixel, const Point& top_left, const Point& bottom_right);
+    void (Framebuffer::*raster_line)(const Point& start, const Point& end, uint32_t pixel, const RasterBand& band);
+    void (Framebuffer::*raster_dotted_line)(const Point& start, const Point& end, uint32_t pixel, int interval, const RasterBand& band);
+    void (Framebuffer::*raster_polygon)(const PolygonShape& shape, uint32_t border_pixel, uint32_t fill_pixel, const Point& top_left, const Point& bottom_right, int xoffset, int yoffset, RasterBand& band);
+    void (Framebuffer::*raster_circle)(const Point& center, int radius, uint32_t pixel, const RasterBand& band);
+    void (Framebuffer::*raster_filled_circle)(const Point& center, int radius, uint32_t border_pixel, uint32_t fill_pixel, const RasterBand& band);
+    BandTask sprite_band;
+    BandTask fill_rect_band;
+    BandTask execute_band;
+    BandTask composite_band;
+    BandTask scaled_composite_band;
+  };
+
+  /* Point raster_ at the instantiations for Format */
+  template <class Format>
+  void SelectPixelFormat();
+
+  /* Set a pixel if it is inside a band, without marking it as damaged */
+  template <class Format>
+  void PutPixel(int x, int y, uint32_t pixel, const RasterBand& band);
+
+  /* Fill the pixels from x0 to x1 (x0 <= x1) of row y, clipped to the clip
+  rectangle and the screen, without marking them as damaged */
+  template <class Format>
+  void RasterSpan(int y, int x0, int x1, uint32_t pixel, const Point& top_left, const Point& bottom_right);
+
+  /* Fill length pixels of row y starting at x, without bounds checking or
+  marking them as damaged */
+  template <class Format>
+  void WriteRun(int x, int y, int length, uint32_t pixel);
+
+  /* Set a pixel without bounds checking or marking it as damaged */
+  template <class Format>
+  void WritePixel(int x, int y, uint32_t pixel);
+
+  /* Checks whether a packed pixel is written as it is rather than blended */
+  bool IsOpaqueWrite(uint32_t pixel) const;
+
+  /* Checks whether (x, y) is inside the screen */
+  bool IsInsideScreen(int x, int y) const;
+
+  /* Checks whether (x, y) is inside a band */
+  bool IsInsideBand(int x, int y, const RasterBand& band) const;
+
+  /* Draw the part of a line inside a band without marking it as damaged,
+  lines that lie inside the band skip the per pixel bounds check */
+  template <class Format>
+  void RasterLine(const Point& start, const Point& end, uint32_t pixel, const RasterBand& band);
+
   /* Draw a line with specified color from the specified start and end point
   with low gradient (0 < m < 1 or -1 < m < 0) in the framebuffer using Bresenham algorithm */
-  void DrawLineLow(const Point& start, const Point& end, const Color& color);
+  template <class Format>
+  void DrawLineLow(const Point& start, const Point& end, uint32_t pixel, const RasterBand& band, bool inside);
 
   /* Draw a line with specified color from the specified start and end point
   with steep gradient (> 1 or < -1) in the framebuffer using Bresenham algorithm */
-  void DrawLineHigh(const Point& start, const Point& end, const Color& color);
+  template <class Format>
+  void DrawLineHigh(const Point& start, const Point& end, uint32_t pixel, const RasterBand& band, bool inside);
+
+  /* Draw the part of a polygon edge between 24.8 end points inside a band,
+  sampled at pixel centres like the edge table so that the outline meets the
+  fill */
+  template <class Format>
+  void RasterEdge(Coord x0, Coord y0, Coord x1, Coord y1, uint32_t pixel, const RasterBand& band);
+
+  /* Draw the part of a dotted line inside a band without marking it as damaged */
+  template <class Format>
+  void RasterDottedLine(const Point& start, const Point& end, uint32_t pixel, int interval, const RasterBand& band);
 
   /* Draw a dotted line with specified color from the specified start and end point
   with low gradient (0 < m < 1 or -1 < m < 0) in the framebuffer using Bresenham algorithm */
-  void DrawDottedLineLow(const Point& start, const Point& end, const Color& color, int interval);
+  template <class Format>
+  void DrawDottedLineLow(const Point& start, const Point& end, uint32_t pixel, int interval, const RasterBand& band);
 
   /* Draw a dotted line with specified color from the specified start and end point
   with steep gradient (> 1 or < -1) in the framebuffer using Bresenham algorithm */
-  void DrawDottedLineHigh(const Point& start, const Point& end, const Color& color, int interval);
+  template <class Format>
+  void DrawDottedLineHigh(const Point& start, const Point& end, uint32_t pixel, int interval, const RasterBand& band);
+
+  /* Fill the inside of a polygon inside a band, scanline by scanline, with an
+  active edge list */
+  template <class Format>
+  void FillEdgeTable(const PolygonShape& shape, uint32_t pixel, const Point& top_left, const Point& bottom_right, int xoffset, int yoffset, RasterBand& band);
+
+  /* Fill and outline the part of a polygon inside a band, without marking it
+  as damaged */
+  template <class Format>
+  void RasterPolygon(const PolygonShape& shape, uint32_t border_pixel, uint32_t fill_pixel, const Point& top_left, const Point& bottom_right, int xoffset, int yoffset, RasterBand& band);
+
+  /* Draw the part of a circle outline inside a band, without marking it as damaged */
+  template <class Format>
+  void RasterCircle(const Point& center, int radius, uint32_t pixel, const RasterBand& band);
+
+  /* Draw the part of a filled circle inside a band, without marking it as damaged */
+  template <class Format>
+  void RasterFilledCircle(const Point& center, int radius, uint32_t border_pixel, uint32_t fill_pixel, const RasterBand& band);
+
+  /* Split the rows of the rectangle (x_first, y_first) - (x_last, y_last) into
+  bands and run task on each of them, on the raster threads if there are more
+  than one. Returns when all are done */
+  void RunBanded(int x_first, int y_first, int x_last, int y_last, BandTask task, const void *job);
+
+  /* Thread pool entry point of RunBanded */
+  static void RunBandTask(void *context, int index);
+
+  /* Band tasks */
+  template <class Format>
+  void RasterSpriteBand(RasterBand& band, const void *job);
+  template <class Format>
+  void FillRectBand(RasterBand& band, const void *job);
+  template <class Format>
+  void ExecuteBand(RasterBand& band, const void *job);
+  template <class Format>
+  void CompositeBand(RasterBand& band, const void *job);
+  template <class Format>
+  void ScaledCompositeBand(RasterBand& band, const void *job);
 
-  /* Set the rastered polygon line intersections */
-  void SetRasteredPolygonIntersections(const Point& start, const Point& end, std::vector<std::vector<int>>& intersections, int ymin);
+  /* A band covering the whole screen, for single threaded drawing */
+  RasterBand& GetScreenBand();
 
-  /* Set the rastered polygon line with low gradient (0 < m < 1 or -1 < m < 0)
-  intersections */
-  void SetRasteredPolygonIntersectionsLow(const Point& start, const Point& end, std::vector<std::vector<int>>& intersections, int ymin);
+  /* Transform the points of the count polygons listed, ascending, in indices
+  into the transformed_ scratch space and build their edge tables, taking the
+  first count polygons when indices is NULL. transformed_shapes_[i] is the
+  shape of polygon i until the next call. Polygons whose moved box is outside
+  the clip rectangle get an empty shape, unless boxes is NULL */
+  void TransformShapes(const Coord *xs, const Coord *ys, const SpritePolygon *polygons, const BoundingBox *boxes, const int *indices, int count, const Transform2D& transform, const Point& top_left, const Point& bottom_right);
 
-  /* Set the rastered polygon line with low gradient (0 < m < 1 or -1 < m < 0)
-  intersections */
-  void SetRasteredPolygonIntersectionsHigh(const Point& start, const Point& end, std::vector<std::vector<int>>& intersections, int ymin);
+  /* Mark the damage of the count polygons of a sprite listed in polygons,
+  or of the first count polygons when polygons is NULL, whose shapes are
+  shapes[i] for polygon i, and rasterize them in bands */
+  void RasterSprite(const Sprite& sprite, const PolygonShape *shapes, const int *polygons, int count, const Point& top_left, const Point& bottom_right, int xoffset, int yoffset);
 
-  /* Compute the bit code for a point (x, y) using the clip rectangle */
-  int ComputeOutCode(const Point& p, const Point& top_left, const Point& bottom_right);
+  /* Mark the tiles covered by the rectangle (x0, y0) - (x1, y1) as damaged */
+  void MarkDamaged(int x0, int y0, int x1, int y1);
 
-  int device_;
+  /* Hash the content of a tile in the buffer */
+  uint64_t HashTile(int tile_x, int tile_y) const;
+
+  /* Copy a run of tiles in one tile row from the buffer to the screen, returns the copied bytes */
+  long PresentTiles(int tile_y, int first_tile_x, int last_tile_x);
+
+  /* Read the screen layout from the render target and allocate the buffer */
+  void Init();
+
+  RenderTarget *target_;
   uint8_t *address_; /* pointer to screen memory */
-  uint8_t *buffer_;
+  uint8_t *buffer_; /* where drawing goes, either heap_buffer_ or the hidden page */
+  uint8_t *heap_buffer_;
   int screen_memory_size_;
-  struct fb_fix_screeninfo finfo_;
-  struct fb_var_screeninfo vinfo_;
+  long width_;
+  long height_;
+  int bytes_per_pixel_;
+  int line_length_;
+  RasterFunctions raster_;
+  BlendMode blend_mode_;
+
+  DamageMode damage_mode_;
+  int tiles_x_;
+  int tiles_y_;
+  std::vector<uint8_t> damaged_tiles_;
+  std::vector<uint64_t> tile_hashes_; /* content of each tile at the last Display() */
+  std::vector<uint8_t> tile_hash_valid_;
+  long last_presented_bytes_;
+
+  bool page_flipping_;
+  int front_page_; /* page on screen, also while copying if the target could not pan back */
+
+  ThreadPool *raster_pool_; /* 0 while banding is off */
+  int raster_threads_;
+  std::vector<RasterBand> bands_;
+  int band_count_;
+  BandTask band_task_; /* task and job of the running RunBanded */
+  const void *band_job_;
+
+  /* Scratch space of the transformed draw calls, kept to avoid allocations */
+  CoordArray transformed_xs_;
+  CoordArray transformed_ys_;
+  std::vector<EdgeTable> transformed_tables_;
+  std::vector<PolygonShape> transformed_shapes_;
+  std::vector<int> visible_polygons_; /* of the sprite being drawn */
 };
 
 #endif
@@ -0,0 +1,25 @@
+#include "layer.h"
+#include "memory_render_target.h"
+
+/* Constructor */
+Layer::Layer(long width, long height) : framebuffer_(new MemoryRenderTarget(width, height)) {
+  /* A layer is never displayed, only composited */
+  framebuffer_.SetDamageMode(DAMAGE_OFF);
+}
+
+/* Make every pixel transparent */
+void Layer::Clear() {
+  BlendMode mode = framebuffer_.GetBlendMode();
+  framebuffer_.SetBlendMode(BLEND_REPLACE);
+  framebuffer_.FillRect(Point(0, 0), Point(framebuffer_.GetWidth() - 1, framebuffer_.GetHeight() - 1), Color(0, 0, 0, 0));
+  framebuffer_.SetBlendMode(mode);
+}
+
+/* Getter */
+Framebuffer& Layer::GetFramebuffer() {
+  return framebuffer_;
+}
+
+const Framebuffer& Layer::GetFramebuffer() const {
+  return framebuffer_;
+}
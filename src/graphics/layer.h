@@ -0,0 +1,25 @@
+#ifndef LAYER_H
+#define LAYER_H
+
+#include "framebuffer.h"
+
+/* Off-screen ARGB8888 image, drawn to with the Framebuffer API and blended
+over a Framebuffer with Framebuffer::CompositeLayer. Every pixel starts
+transparent, and the alpha of what is drawn is kept in the padding byte */
+class Layer {
+public:
+  /* Constructor */
+  Layer(long width, long height);
+
+  /* Make every pixel transparent */
+  void Clear();
+
+  /* Getter */
+  Framebuffer& GetFramebuffer();
+  const Framebuffer& GetFramebuffer() const;
+
+private:
+  Framebuffer framebuffer_;
+};
+
+#endif
@@ -0,0 +1,54 @@
+#ifndef LINE_CLIPPER_H
+#define LINE_CLIPPER_H
+
+#include <stdint.h>
+#include <vector>
+#include "point.h"
+
+/* Units of the values in SegmentArrays: whole pixels, or 24.8 fixed point
+coordinates */
+struct PixelUnit {};
+struct CoordUnit {};
+
+/* Line segments stored as one array per coordinate, the layout LineClipper
+works on. Segments of different units are different types, so that one
+cannot be clipped or drawn as the other */
+template <class Unit>
+struct SegmentArrays {
+  std::vector<int32_t> x0;
+  std::vector<int32_t> y0;
+  std::vector<int32_t> x1;
+  std::vector<int32_t> y1;
+
+  /* Make room for count segments */
+  void Reserve(int count) {
+    if ((int) x0.size() < count) {
+      x0.resize(count);
+      y0.resize(count);
+      x1.resize(count);
+      y1.resize(count);
+    }
+  }
+};
+
+typedef SegmentArrays<PixelUnit> PixelSegments;
+typedef SegmentArrays<CoordUnit> CoordSegments;
+
+/* Liang–Barsky clipping of many segments at once, four segments per SSE2
+instruction when the pixel kernels run at KERNEL_SSE2 or above */
+class LineClipper {
+public:
+  /* Clip the first count segments to the rectangle from top_left to
+  bottom_right (inclusive). The segments left are moved to the front, in their
+  original order, and their number is returned */
+  static int Clip(PixelSegments& segments, int count, const Point& top_left, const Point& bottom_right);
+
+  /* Same as above in 24.8 coordinates, the rectangle is taken at the fixed
+  point coordinates of its corners */
+  static int Clip(CoordSegments& segments, int count, const Point& top_left, const Point& bottom_right);
+
+  /* Clip one segment, returns false if nothing is left */
+  static bool Clip(const Point& start, const Point& end, const Point& top_left, const Point& bottom_right, Point& clipped_start, Point& clipped_end);
+};
+
+#endif
@@ -0,0 +1,42 @@
+#include "memory_render_target.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <algorithm>
+
+/* Constructor (line_length defaults to width * bits_per_pixel / 8) */
+MemoryRenderTarget::MemoryRenderTarget(long width, long height, int line_length, int bits_per_pixel, long virtual_height) {
+  if (line_length < width * (bits_per_pixel / 8)) {
+    line_length = width * (bits_per_pixel / 8);
+  }
+
+  width_ = width;
+  height_ = height;
+  virtual_height_ = std::max(height, virtual_height);
+  line_length_ = line_length;
+  bits_per_pixel_ = bits_per_pixel;
+  memory_size_ = virtual_height_ * line_length_;
+
+  memory_ = (uint8_t*) calloc(memory_size_, 1);
+  if (!memory_) {
+    perror("Error: failed to allocate render target memory");
+    exit(5);
+  }
+  pan_count_ = 0;
+}
+
+/* Simulate panning the display to the rows starting at y_offset */
+bool MemoryRenderTarget::Pan(long y_offset) {
+  if (y_offset < 0 || y_offset + height_ > virtual_height_) {
+    return false;
+  }
+  if (y_offset != y_offset_) {
+    y_offset_ = y_offset;
+    pan_count_++;
+  }
+  return true;
+}
+
+/* Destructor */
+MemoryRenderTarget::~MemoryRenderTarget() {
+  free(memory_);
+}
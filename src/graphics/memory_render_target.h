@@ -0,0 +1,28 @@
+#ifndef MEMORY_RENDER_TARGET_H
+#define MEMORY_RENDER_TARGET_H
+
+#include "render_target.h"
+
+/* Off-screen render target backed by heap memory, used to render without a
+display device (profiling, regression testing). A virtual height of at least
+twice the height simulates a panning display. */
+class MemoryRenderTarget : public RenderTarget {
+public:
+  /* Constructor (line_length defaults to width * bits_per_pixel / 8,
+  virtual_height defaults to height) */
+  MemoryRenderTarget(long width, long height, int line_length = 0, int bits_per_pixel = 32, long virtual_height = 0);
+
+  /* Destructor */
+  ~MemoryRenderTarget();
+
+  /* Simulate panning the display to the rows starting at y_offset */
+  bool Pan(long y_offset);
+
+  /* Getter */
+  long GetPanCount() const { return pan_count_; }
+
+private:
+  long pan_count_;
+};
+
+#endif
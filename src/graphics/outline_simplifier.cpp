@@ -0,0 +1,106 @@
+#include "outline_simplifier.h"
+#include <utility>
+#include <vector>
+
+/* Squared distance from (x, y) to the segment from (x0, y0) to (x1, y1) */
+static double SquaredDistance(double x, double y, double x0, double y0, double x1, double y1) {
+  double dx = x1 - x0;
+  double dy = y1 - y0;
+  double length = dx * dx + dy * dy;
+  double t = 0.0;
+  if (length > 0.0) {
+    t = ((x - x0) * dx + (y - y0) * dy) / length;
+    t = t < 0.0 ? 0.0 : (t > 1.0 ? 1.0 : t);
+  }
+  double ex = x0 + t * dx - x;
+  double ey = y0 + t * dy - y;
+  return ex * ex + ey * ey;
+}
+
+/* Simplify a closed outline */
+int OutlineSimplifier::Simplify(const Coord *xs, const Coord *ys, int count, Coord tolerance, CoordArray& rxs, CoordArray& rys) {
+  /* Drop zero length edges, including the closing one */
+  std::vector<int> points;
+  for (int i = 0; i < count; i++) {
+    if (points.empty() || xs[i] != xs[points.back()] || ys[i] != ys[points.back()]) {
+      points.push_back(i);
+    }
+  }
+  while (points.size() > 1 && xs[points.back()] == xs[points[0]] && ys[points.back()] == ys[points[0]]) {
+    points.pop_back();
+  }
+  int n = points.size();
+
+  /* Split the outline at its first point and the point furthest from it, then
+  keep the furthest point of every chain that strays beyond tolerance */
+  std::vector<bool> is_kept(n, n <= 3);
+  if (n > 3) {
+    int furthest = 0;
+    double furthest_distance = -1.0;
+    for (int i = 1; i < n; i++) {
+      double dx = xs[points[i]] - xs[points[0]];
+      double dy = ys[points[i]] - ys[points[0]];
+      if (dx * dx + dy * dy > furthest_distance) {
+        furthest_distance = dx * dx + dy * dy;
+        furthest = i;
+      }
+    }
+    is_kept[0] = is_kept[furthest] = true;
+
+    /* Chains from point first to point last, where n stands for point 0 */
+    double squared_tolerance = (double) tolerance * tolerance;
+    std::vector<std::pair<int, int> > chains;
+    chains.push_back(std::make_pair(0, furthest));
+    chains.push_back(std::make_pair(furthest, n));
+    while (!chains.empty()) {
+      int first = chains.back().first;
+      int last = chains.back().second;
+      chains.pop_back();
+      int split = -1;
+      double split_distance = 0.0;
+      for (int i = first + 1; i < last; i++) {
+        double distance = SquaredDistance(xs[points[i]], ys[points[i]], xs[points[first]], ys[points[first]], xs[points[last % n]], ys[points[last % n]]);
+        if (distance > split_distance) {
+          split_distance = distance;
+          split = i;
+        }
+      }
+      if (split >= 0 && split_distance > squared_tolerance) {
+        is_kept[split] = true;
+        chains.push_back(std::make_pair(first, split));
+        chains.push_back(std::make_pair(split, last));
+      }
+    }
+
+    /* An outline thinner than tolerance keeps its widest triangle, so that it
+    still covers pixels */
+    int kept = 0;
+    for (int i = 0; i < n; i++) {
+      kept += is_kept[i];
+    }
+    if (kept < 3) {
+      int widest = -1;
+      double widest_distance = 0.0;
+      for (int i = 1; i < n; i++) {
+        double distance = SquaredDistance(xs[points[i]], ys[points[i]], xs[points[0]], ys[points[0]], xs[points[furthest]], ys[points[furthest]]);
+        if (i != furthest && distance > widest_distance) {
+          widest_distance = distance;
+          widest = i;
+        }
+      }
+      if (widest >= 0) {
+        is_kept[widest] = true;
+      }
+    }
+  }
+
+  int appended = 0;
+  for (int i = 0; i < n; i++) {
+    if (is_kept[i]) {
+      rxs.push_back(xs[points[i]]);
+      rys.push_back(ys[points[i]]);
+      appended++;
+    }
+  }
+  return appended;
+}
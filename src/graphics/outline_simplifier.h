@@ -0,0 +1,20 @@
+#ifndef OUTLINE_SIMPLIFIER_H
+#define OUTLINE_SIMPLIFIER_H
+
+#include "fixed.h"
+#include "polygon.h"
+
+/* Douglas–Peucker simplification of closed outlines, used to build the
+coarser levels of detail of a sprite */
+class OutlineSimplifier {
+public:
+  /* Append to rxs and rys the points of the closed outline of count points
+  (xs[i], ys[i]) that are left once zero length edges are dropped and every
+  point within tolerance (24.8 fixed point) of the simplified outline is
+  removed, in their original order, so collinear points go too. Outlines of
+  up to 3 points are kept whole, longer ones keep at least 3 points unless
+  they all lie on one line. Returns the number of points appended */
+  static int Simplify(const Coord *xs, const Coord *ys, int count, Coord tolerance, CoordArray& rxs, CoordArray& rys);
+};
+
+#endif
@@ -0,0 +1,186 @@
+#ifndef PIXEL_FORMAT_H
+#define PIXEL_FORMAT_H
+
+#include <stdint.h>
+#include <cstring>
+#include "color.h"
+#include "pixel_kernels.h"
+
+/* Pixel formats the Framebuffer can draw in. Each one packs a Color into the
+value written to memory once per draw call, and the raster code is
+instantiated per format so its inner loops never test the format. Packed
+values keep the alpha of the color in their top byte for Blend */
+
+/* 32 bits per pixel, stored as B, G, R, X */
+struct PixelXRGB8888 {
+  static const int BYTES = 4;
+
+  static uint32_t Pack(const Color& color) {
+    return color.GetPixel();
+  }
+
+  static Color Unpack(const uint8_t *pixel) {
+    uint32_t value;
+    memcpy(&value, pixel, 4);
+    return Color::FromPixel(value);
+  }
+
+  static void Write(uint8_t *pixel, uint32_t value) {
+    memcpy(pixel, &value, 4);
+  }
+
+  static void Fill(uint8_t *dst, uint32_t value, long count, bool streaming) {
+    if (count >= 16) {
+      PixelKernels::Fill32(dst, value, count, streaming);
+    } else {
+      for (long i = 0; i < count; i++) {
+        memcpy(dst + i * 4, &value, 4);
+      }
+    }
+  }
+
+  static void Blend(uint8_t *dst, uint32_t value, long count) {
+    if (count >= 8) {
+      PixelKernels::Blend32(dst, value, count);
+    } else {
+      for (long i = 0; i < count; i++) {
+        uint32_t pixel;
+        memcpy(&pixel, dst + i * 4, 4);
+        pixel = PixelKernels::BlendPixel(pixel, value);
+        memcpy(dst + i * 4, &pixel, 4);
+      }
+    }
+  }
+
+  static void Composite(uint8_t *dst, const uint8_t *src, long count) {
+    PixelKernels::Composite32(dst, src, count);
+  }
+};
+
+/* 24 bits per pixel, stored as B, G, R */
+struct PixelRGB888 {
+  static const int BYTES = 3;
+
+  static uint32_t Pack(const Color& color) {
+    return color.GetPixel();
+  }
+
+  static Color Unpack(const uint8_t *pixel) {
+    return Color(pixel[2], pixel[1], pixel[0]);
+  }
+
+  static void Write(uint8_t *pixel, uint32_t value) {
+    pixel[0] = value;
+    pixel[1] = value >> 8;
+    pixel[2] = value >> 16;
+  }
+
+  static void Fill(uint8_t *dst, uint32_t value, long count, bool streaming) {
+    (void) streaming;
+    /* Four pixels are three whole words */
+    uint8_t pattern[12];
+    for (int i = 0; i < 4; i++) {
+      Write(pattern + i * 3, value);
+    }
+    long i = 0;
+    for (; i + 4 <= count; i += 4) {
+      memcpy(dst + i * 3, pattern, sizeof(pattern));
+    }
+    for (; i < count; i++) {
+      Write(dst + i * 3, value);
+    }
+  }
+
+  static void Blend(uint8_t *dst, uint32_t value, long count) {
+    for (long i = 0; i < count; i++) {
+      uint8_t *pixel = dst + i * 3;
+      Write(pixel, PixelKernels::BlendPixel((pixel[2] << 16) | (pixel[1] << 8) | pixel[0], value));
+    }
+  }
+
+  static void Composite(uint8_t *dst, const uint8_t *src, long count) {
+    for (long i = 0; i < count; i++) {
+      uint32_t color;
+      memcpy(&color, src + i * 4, 4);
+      if ((color >> 24) != 0) {
+        Blend(dst + i * 3, color, 1);
+      }
+    }
+  }
+};
+
+/* 16 bits per pixel, 5 bits red, 6 bits green, 5 bits blue */
+struct PixelRGB565 {
+  static const int BYTES = 2;
+
+  static uint32_t Pack(const Color& color) {
+    return ((uint32_t) color.GetA() << 24) | ((color.GetR() & 0xf8) << 8) | ((color.GetG() & 0xfc) << 3) | (color.GetB() >> 3);
+  }
+
+  static Color Unpack(const uint8_t *pixel) {
+    uint16_t value;
+    memcpy(&value, pixel, 2);
+    return Color::FromPixel(Widen(value));
+  }
+
+  /* XRGB8888 value of an RGB565 value, the low bits repeat the high ones */
+  static uint32_t Widen(uint32_t value) {
+    uint32_t r = (value >> 11) & 0x1f;
+    uint32_t g = (value >> 5) & 0x3f;
+    uint32_t b = value & 0x1f;
+    return (((r << 3) | (r >> 2)) << 16) | (((g << 2) | (g >> 4)) << 8) | ((b << 3) | (b >> 2));
+  }
+
+  /* RGB565 value of an XRGB8888 value */
+  static uint32_t Narrow(uint32_t value) {
+    return ((value >> 8) & 0xf800) | ((value >> 5) & 0x07e0) | ((value >> 3) & 0x001f);
+  }
+
+  static void Write(uint8_t *pixel, uint32_t value) {
+    uint16_t half = value;
+    memcpy(pixel, &half, 2);
+  }
+
+  static void Fill(uint8_t *dst, uint32_t value, long count, bool streaming) {
+    if (count < 32) {
+      for (long i = 0; i < count; i++) {
+        Write(dst + i * 2, value);
+      }
+      return;
+    }
+    /* Pairs of pixels are 32 bit words once dst is 4 byte aligned */
+    if ((uintptr_t) dst & 2) {
+      Write(dst, value);
+      dst += 2;
+      count--;
+    }
+    PixelKernels::Fill32(dst, (value & 0xffff) * 0x10001, count / 2, streaming);
+    if (count & 1) {
+      Write(dst + (count - 1) * 2, value);
+    }
+  }
+
+  /* Blended in 8 bits per channel and narrowed once per pixel */
+  static void Blend(uint8_t *dst, uint32_t value, long count) {
+    uint32_t color = (value & 0xff000000) | Widen(value);
+    for (long i = 0; i < count; i++) {
+      uint16_t pixel;
+      memcpy(&pixel, dst + i * 2, 2);
+      Write(dst + i * 2, Narrow(PixelKernels::BlendPixel(Widen(pixel), color)));
+    }
+  }
+
+  static void Composite(uint8_t *dst, const uint8_t *src, long count) {
+    for (long i = 0; i < count; i++) {
+      uint32_t color;
+      memcpy(&color, src + i * 4, 4);
+      if ((color >> 24) != 0) {
+        uint16_t pixel;
+        memcpy(&pixel, dst + i * 2, 2);
+        Write(dst + i * 2, Narrow(PixelKernels::BlendPixel(Widen(pixel), color)));
+      }
+    }
+  }
+};
+
+#endif
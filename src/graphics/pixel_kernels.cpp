@@ -0,0 +1,374 @@
+#include "pixel_kernels.h"
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define PIXEL_KERNELS_X86
+#include <immintrin.h>
+#endif
+
+/* Scalar fallback */
+static void Fill32Scalar(uint8_t *dst, uint32_t value, long count, bool streaming) {
+  (void) streaming;
+  for (long i = 0; i < count; i++) {
+    memcpy(dst + i * 4, &value, 4);
+  }
+}
+
+static void StreamCopyScalar(uint8_t *dst, const uint8_t *src, long size) {
+  memcpy(dst, src, size);
+}
+
+static void Blend32Scalar(uint8_t *dst, uint32_t color, long count) {
+  for (long i = 0; i < count; i++) {
+    uint32_t pixel;
+    memcpy(&pixel, dst + i * 4, 4);
+    pixel = PixelKernels::BlendPixel(pixel, color);
+    memcpy(dst + i * 4, &pixel, 4);
+  }
+}
+
+static void Composite32Scalar(uint8_t *dst, const uint8_t *src, long count) {
+  for (long i = 0; i < count; i++) {
+    uint32_t color;
+    memcpy(&color, src + i * 4, 4);
+    if ((color >> 24) == 0) {
+      continue;
+    }
+    uint32_t pixel;
+    memcpy(&pixel, dst + i * 4, 4);
+    pixel = PixelKernels::BlendPixel(pixel, color);
+    memcpy(dst + i * 4, &pixel, 4);
+  }
+}
+
+#ifdef PIXEL_KERNELS_X86
+/* SSE2 kernels, 4 pixels per store */
+static void Fill32SSE2(uint8_t *dst, uint32_t value, long count, bool streaming) {
+  /* Align the destination to 16 bytes (pixels are at least 4 byte aligned) */
+  while (count > 0 && ((uintptr_t) dst & 15)) {
+    memcpy(dst, &value, 4);
+    dst += 4;
+    count--;
+  }
+
+  __m128i pixels = _mm_set1_epi32(value);
+  long i = 0;
+  if (streaming) {
+    for (; i + 16 <= count; i += 16) {
+      _mm_stream_si128((__m128i*) (dst + i * 4), pixels);
+      _mm_stream_si128((__m128i*) (dst + i * 4 + 16), pixels);
+      _mm_stream_si128((__m128i*) (dst + i * 4 + 32), pixels);
+      _mm_stream_si128((__m128i*) (dst + i * 4 + 48), pixels);
+    }
+    _mm_sfence();
+  }
+  for (; i + 4 <= count; i += 4) {
+    _mm_store_si128((__m128i*) (dst + i * 4), pixels);
+  }
+  for (; i < count; i++) {
+    memcpy(dst + i * 4, &value, 4);
+  }
+}
+
+static void StreamCopySSE2(uint8_t *dst, const uint8_t *src, long size) {
+  long head = (16 - ((uintptr_t) dst & 15)) & 15;
+  if (head > size) {
+    head = size;
+  }
+  memcpy(dst, src, head);
+  dst += head;
+  src += head;
+  size -= head;
+
+  long i = 0;
+  for (; i + 64 <= size; i += 64) {
+    __m128i a = _mm_loadu_si128((const __m128i*) (src + i));
+    __m128i b = _mm_loadu_si128((const __m128i*) (src + i + 16));
+    __m128i c = _mm_loadu_si128((const __m128i*) (src + i + 32));
+    __m128i d = _mm_loadu_si128((const __m128i*) (src + i + 48));
+    _mm_stream_si128((__m128i*) (dst + i), a);
+    _mm_stream_si128((__m128i*) (dst + i + 16), b);
+    _mm_stream_si128((__m128i*) (dst + i + 32), c);
+    _mm_stream_si128((__m128i*) (dst + i + 48), d);
+  }
+  for (; i + 16 <= size; i += 16) {
+    _mm_stream_si128((__m128i*) (dst + i), _mm_loadu_si128((const __m128i*) (src + i)));
+  }
+  _mm_sfence();
+  memcpy(dst + i, src + i, size - i);
+}
+
+/* Blend two pixels widened to 16 bit channels: (source * alpha + pixel *
+(255 - alpha) + 128) / 255, where source_alpha_128 holds source * alpha + 128 */
+static inline __m128i BlendChannelsSSE2(__m128i pixel, __m128i inverse_alpha, __m128i source_alpha_128) {
+  __m128i t = _mm_add_epi16(_mm_mullo_epi16(pixel, inverse_alpha), source_alpha_128);
+  return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+}
+
+static void Blend32SSE2(uint8_t *dst, uint32_t color, long count) {
+  __m128i zero = _mm_setzero_si128();
+  __m128i alpha = _mm_set1_epi16(color >> 24);
+  __m128i inverse_alpha = _mm_set1_epi16(255 - (color >> 24));
+  __m128i source = _mm_unpacklo_epi8(_mm_set1_epi32(color | 0xff000000), zero);
+  __m128i source_alpha_128 = _mm_add_epi16(_mm_mullo_epi16(source, alpha), _mm_set1_epi16(128));
+
+  long i = 0;
+  for (; i + 4 <= count; i += 4) {
+    __m128i pixels = _mm_loadu_si128((const __m128i*) (dst + i * 4));
+    __m128i low = BlendChannelsSSE2(_mm_unpacklo_epi8(pixels, zero), inverse_alpha, source_alpha_128);
+    __m128i high = BlendChannelsSSE2(_mm_unpackhi_epi8(pixels, zero), inverse_alpha, source_alpha_128);
+    _mm_storeu_si128((__m128i*) (dst + i * 4), _mm_packus_epi16(low, high));
+  }
+  Blend32Scalar(dst + i * 4, color, count - i);
+}
+
+/* Blend two pixels widened to 16 bit channels with their own alpha */
+static inline __m128i CompositeChannelsSSE2(__m128i pixel, __m128i source) {
+  __m128i alpha = _mm_shufflehi_epi16(_mm_shufflelo_epi16(source, 0xff), 0xff);
+  __m128i inverse_alpha = _mm_sub_epi16(_mm_set1_epi16(255), alpha);
+  /* The alpha channel of the source counts as 255 */
+  source = _mm_or_si128(source, _mm_set_epi16(255, 0, 0, 0, 255, 0, 0, 0));
+  __m128i t = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(source, alpha), _mm_mullo_epi16(pixel, inverse_alpha)), _mm_set1_epi16(128));
+  return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+}
+
+static void Composite32SSE2(uint8_t *dst, const uint8_t *src, long count) {
+  __m128i zero = _mm_setzero_si128();
+  __m128i alpha_mask = _mm_set1_epi32(0xff000000);
+  long i = 0;
+  for (; i + 4 <= count; i += 4) {
+    __m128i sources = _mm_loadu_si128((const __m128i*) (src + i * 4));
+    __m128i alphas = _mm_and_si128(sources, alpha_mask);
+    /* Skip runs of invisible pixels and copy runs of opaque ones */
+    if (_mm_movemask_epi8(_mm_cmpeq_epi32(alphas, zero)) == 0xffff) {
+      continue;
+    }
+    if (_mm_movemask_epi8(_mm_cmpeq_epi32(alphas, alpha_mask)) == 0xffff) {
+      _mm_storeu_si128((__m128i*) (dst + i * 4), sources);
+      continue;
+    }
+    __m128i pixels = _mm_loadu_si128((const __m128i*) (dst + i * 4));
+    __m128i low = CompositeChannelsSSE2(_mm_unpacklo_epi8(pixels, zero), _mm_unpacklo_epi8(sources, zero));
+    __m128i high = CompositeChannelsSSE2(_mm_unpackhi_epi8(pixels, zero), _mm_unpackhi_epi8(sources, zero));
+    _mm_storeu_si128((__m128i*) (dst + i * 4), _mm_packus_epi16(low, high));
+  }
+  Composite32Scalar(dst + i * 4, src + i * 4, count - i);
+}
+
+/* AVX2 kernels, 8 pixels per store */
+__attribute__((target("avx2")))
+static void Fill32AVX2(uint8_t *dst, uint32_t value, long count, bool streaming) {
+  /* Align the destination to 32 bytes (pixels are at least 4 byte aligned) */
+  while (count > 0 && ((uintptr_t) dst & 31)) {
+    memcpy(dst, &value, 4);
+    dst += 4;
+    count--;
+  }
+
+  __m256i pixels = _mm256_set1_epi32(value);
+  long i = 0;
+  if (streaming) {
+    for (; i + 32 <= count; i += 32) {
+      _mm256_stream_si256((__m256i*) (dst + i * 4), pixels);
+      _mm256_stream_si256((__m256i*) (dst + i * 4 + 32), pixels);
+      _mm256_stream_si256((__m256i*) (dst + i * 4 + 64), pixels);
+      _mm256_stream_si256((__m256i*) (dst + i * 4 + 96), pixels);
+    }
+    _mm_sfence();
+  }
+  for (; i + 8 <= count; i += 8) {
+    _mm256_store_si256((__m256i*) (dst + i * 4), pixels);
+  }
+  for (; i < count; i++) {
+    memcpy(dst + i * 4, &value, 4);
+  }
+}
+
+__attribute__((target("avx2")))
+static void StreamCopyAVX2(uint8_t *dst, const uint8_t *src, long size) {
+  long head = (32 - ((uintptr_t) dst & 31)) & 31;
+  if (head > size) {
+    head = size;
+  }
+  memcpy(dst, src, head);
+  dst += head;
+  src += head;
+  size -= head;
+
+  long i = 0;
+  for (; i + 128 <= size; i += 128) {
+    __m256i a = _mm256_loadu_si256((const __m256i*) (src + i));
+    __m256i b = _mm256_loadu_si256((const __m256i*) (src + i + 32));
+    __m256i c = _mm256_loadu_si256((const __m256i*) (src + i + 64));
+    __m256i d = _mm256_loadu_si256((const __m256i*) (src + i + 96));
+    _mm256_stream_si256((__m256i*) (dst + i), a);
+    _mm256_stream_si256((__m256i*) (dst + i + 32), b);
+    _mm256_stream_si256((__m256i*) (dst + i + 64), c);
+    _mm256_stream_si256((__m256i*) (dst + i + 96), d);
+  }
+  for (; i + 32 <= size; i += 32) {
+    _mm256_stream_si256((__m256i*) (dst + i), _mm256_loadu_si256((const __m256i*) (src + i)));
+  }
+  _mm_sfence();
+  memcpy(dst + i, src + i, size - i);
+}
+
+/* Same as BlendChannelsSSE2, four pixels at a time */
+__attribute__((target("avx2")))
+static inline __m256i BlendChannelsAVX2(__m256i pixel, __m256i inverse_alpha, __m256i source_alpha_128) {
+  __m256i t = _mm256_add_epi16(_mm256_mullo_epi16(pixel, inverse_alpha), source_alpha_128);
+  return _mm256_srli_epi16(_mm256_add_epi16(t, _mm256_srli_epi16(t, 8)), 8);
+}
+
+__attribute__((target("avx2")))
+static void Blend32AVX2(uint8_t *dst, uint32_t color, long count) {
+  __m256i zero = _mm256_setzero_si256();
+  __m256i alpha = _mm256_set1_epi16(color >> 24);
+  __m256i inverse_alpha = _mm256_set1_epi16(255 - (color >> 24));
+  __m256i source = _mm256_unpacklo_epi8(_mm256_set1_epi32(color | 0xff000000), zero);
+  __m256i source_alpha_128 = _mm256_add_epi16(_mm256_mullo_epi16(source, alpha), _mm256_set1_epi16(128));
+
+  long i = 0;
+  for (; i + 8 <= count; i += 8) {
+    __m256i pixels = _mm256_loadu_si256((const __m256i*) (dst + i * 4));
+    __m256i low = BlendChannelsAVX2(_mm256_unpacklo_epi8(pixels, zero), inverse_alpha, source_alpha_128);
+    __m256i high = BlendChannelsAVX2(_mm256_unpackhi_epi8(pixels, zero), inverse_alpha, source_alpha_128);
+    _mm256_storeu_si256((__m256i*) (dst + i * 4), _mm256_packus_epi16(low, high));
+  }
+  /* Clear the upper halves before running SSE code, which would stall otherwise */
+  _mm256_zeroupper();
+  Blend32SSE2(dst + i * 4, color, count - i);
+}
+
+/* Same as CompositeChannelsSSE2, four pixels at a time */
+__attribute__((target("avx2")))
+static inline __m256i CompositeChannelsAVX2(__m256i pixel, __m256i source) {
+  __m256i alpha = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(source, 0xff), 0xff);
+  __m256i inverse_alpha = _mm256_sub_epi16(_mm256_set1_epi16(255), alpha);
+  source = _mm256_or_si256(source, _mm256_set1_epi64x(0x00ff000000000000LL));
+  __m256i t = _mm256_add_epi16(_mm256_add_epi16(_mm256_mullo_epi16(source, alpha), _mm256_mullo_epi16(pixel, inverse_alpha)), _mm256_set1_epi16(128));
+  return _mm256_srli_epi16(_mm256_add_epi16(t, _mm256_srli_epi16(t, 8)), 8);
+}
+
+__attribute__((target("avx2")))
+static void Composite32AVX2(uint8_t *dst, const uint8_t *src, long count) {
+  __m256i zero = _mm256_setzero_si256();
+  __m256i alpha_mask = _mm256_set1_epi32(0xff000000);
+  long i = 0;
+  for (; i + 8 <= count; i += 8) {
+    __m256i sources = _mm256_loadu_si256((const __m256i*) (src + i * 4));
+    __m256i alphas = _mm256_and_si256(sources, alpha_mask);
+    if (_mm256_movemask_epi8(_mm256_cmpeq_epi32(alphas, zero)) == -1) {
+      continue;
+    }
+    if (_mm256_movemask_epi8(_mm256_cmpeq_epi32(alphas, alpha_mask)) == -1) {
+      _mm256_storeu_si256((__m256i*) (dst + i * 4), sources);
+      continue;
+    }
+    __m256i pixels = _mm256_loadu_si256((const __m256i*) (dst + i * 4));
+    __m256i low = CompositeChannelsAVX2(_mm256_unpacklo_epi8(pixels, zero), _mm256_unpacklo_epi8(sources, zero));
+    __m256i high = CompositeChannelsAVX2(_mm256_unpackhi_epi8(pixels, zero), _mm256_unpackhi_epi8(sources, zero));
+    _mm256_storeu_si256((__m256i*) (dst + i * 4), _mm256_packus_epi16(low, high));
+  }
+  _mm256_zeroupper();
+  Composite32SSE2(dst + i * 4, src + i * 4, count - i);
+}
+#endif
+
+/* Start with the scalar kernels so calls made during static initialization are
+safe, then switch to the best supported level */
+KernelLevel PixelKernels::level_ = KERNEL_SCALAR;
+PixelKernels::FillFunction PixelKernels::fill32_ = Fill32Scalar;
+PixelKernels::CopyFunction PixelKernels::stream_copy_ = StreamCopyScalar;
+PixelKernels::BlendFunction PixelKernels::blend32_ = Blend32Scalar;
+PixelKernels::CompositeFunction PixelKernels::composite32_ = Composite32Scalar;
+
+static struct PixelKernelsInitializer {
+  PixelKernelsInitializer() {
+    PixelKernels::SetLevel(PixelKernels::GetSupportedLevel());
+  }
+} pixel_kernels_initializer;
+
+/* Fill count 32 bit pixels starting at dst with value */
+void PixelKernels::Fill32(uint8_t *dst, uint32_t value, long count, bool streaming) {
+  fill32_(dst, value, count, streaming);
+}
+
+/* Copy size bytes from src to screen memory with non-temporal stores */
+void PixelKernels::StreamCopy(uint8_t *dst, const uint8_t *src, long size) {
+  stream_copy_(dst, src, size);
+}
+
+/* Blend an ARGB8888 color over count 32 bit pixels starting at dst */
+void PixelKernels::Blend32(uint8_t *dst, uint32_t color, long count) {
+  blend32_(dst, color, count);
+}
+
+/* Blend count ARGB8888 pixels from src over count 32 bit pixels starting at dst */
+void PixelKernels::Composite32(uint8_t *dst, const uint8_t *src, long count) {
+  composite32_(dst, src, count);
+}
+
+/* Best level supported by this CPU */
+KernelLevel PixelKernels::GetSupportedLevel() {
+#ifdef PIXEL_KERNELS_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    return KERNEL_AVX2;
+  }
+  if (__builtin_cpu_supports("sse2")) {
+    return KERNEL_SSE2;
+  }
+#endif
+  return KERNEL_SCALAR;
+}
+
+/* Getter */
+KernelLevel PixelKernels::GetLevel() {
+  return level_;
+}
+
+/* Setter (levels above the supported one are lowered to it) */
+void PixelKernels::SetLevel(KernelLevel level) {
+  KernelLevel supported = GetSupportedLevel();
+  if (level > supported) {
+    level = supported;
+  }
+
+  level_ = level;
+  switch (level) {
+#ifdef PIXEL_KERNELS_X86
+    case KERNEL_AVX2:
+      fill32_ = Fill32AVX2;
+      stream_copy_ = StreamCopyAVX2;
+      blend32_ = Blend32AVX2;
+      composite32_ = Composite32AVX2;
+      break;
+    case KERNEL_SSE2:
+      fill32_ = Fill32SSE2;
+      stream_copy_ = StreamCopySSE2;
+      blend32_ = Blend32SSE2;
+      composite32_ = Composite32SSE2;
+      break;
+#endif
+    default:
+      level_ = KERNEL_SCALAR;
+      fill32_ = Fill32Scalar;
+      stream_copy_ = StreamCopyScalar;
+      blend32_ = Blend32Scalar;
+      composite32_ = Composite32Scalar;
+      break;
+  }
+}
+
+/* Name of a level, for logs and benchmarks */
+const char *PixelKernels::GetLevelName(KernelLevel level) {
+  switch (level) {
+    case KERNEL_AVX2:
+      return "avx2";
+    case KERNEL_SSE2:
+      return "sse2";
+    default:
+      return "scalar";
+  }
+}
@@ -0,0 +1,72 @@
+#ifndef PIXEL_KERNELS_H
+#define PIXEL_KERNELS_H
+
+#include <stdint.h>
+
+/* Instruction set used by the pixel kernels */
+enum KernelLevel {
+  KERNEL_SCALAR,
+  KERNEL_SSE2,
+  KERNEL_AVX2
+};
+
+/* Bulk pixel fill and copy routines, dispatched once at startup to the best
+instruction set the CPU supports */
+class PixelKernels {
+public:
+  /* Fill count 32 bit pixels starting at dst with value. Streaming fills use
+  non-temporal stores, meant for screen memory and buffers larger than the cache */
+  static void Fill32(uint8_t *dst, uint32_t value, long count, bool streaming = false);
+
+  /* Copy size bytes from src to screen memory with non-temporal stores */
+  static void StreamCopy(uint8_t *dst, const uint8_t *src, long size);
+
+  /* Blend an ARGB8888 color over count 32 bit pixels starting at dst */
+  static void Blend32(uint8_t *dst, uint32_t color, long count);
+
+  /* Blend count ARGB8888 pixels from src over count 32 bit pixels starting at dst */
+  static void Composite32(uint8_t *dst, const uint8_t *src, long count);
+
+  /* Blend an ARGB8888 color over one 32 bit pixel. Every channel, alpha
+  included, becomes (color * a + pixel * (255 - a)) / 255 rounded, with the
+  alpha of the color counted as 255, so an opaque pixel stays opaque */
+  static uint32_t BlendPixel(uint32_t pixel, uint32_t color);
+
+  /* Best level supported by this CPU */
+  static KernelLevel GetSupportedLevel();
+
+  /* Getter */
+  static KernelLevel GetLevel();
+
+  /* Setter (levels above the supported one are lowered to it) */
+  static void SetLevel(KernelLevel level);
+
+  /* Name of a level, for logs and benchmarks */
+  static const char *GetLevelName(KernelLevel level);
+
+private:
+  typedef void (*FillFunction)(uint8_t *dst, uint32_t value, long count, bool streaming);
+  typedef void (*CopyFunction)(uint8_t *dst, const uint8_t *src, long size);
+  typedef void (*BlendFunction)(uint8_t *dst, uint32_t color, long count);
+  typedef void (*CompositeFunction)(uint8_t *dst, const uint8_t *src, long count);
+
+  static KernelLevel level_;
+  static FillFunction fill32_;
+  static CopyFunction stream_copy_;
+  static BlendFunction blend32_;
+  static CompositeFunction composite32_;
+};
+
+/* Kept in the header so single pixel blends inline into the raster loops */
+inline uint32_t PixelKernels::BlendPixel(uint32_t pixel, uint32_t color) {
+  uint32_t a = color >> 24;
+  uint32_t source = color | 0xff000000;
+  uint32_t result = 0;
+  for (int shift = 0; shift < 32; shift += 8) {
+    uint32_t t = ((source >> shift) & 0xff) * a + ((pixel >> shift) & 0xff) * (255 - a) + 128;
+    result |= ((t + (t >> 8)) >> 8) << shift;
+  }
+  return result;
+}
+
+#endif
@@ -1,92 +1,94 @@
 #include "point.h"
-#include <cmath>
+#include "transform.h"
 
 /* Constructor */
 Point::Point() : x_(0), y_(0) {}
 
-Point::Point(int x, int y): x_(x), y_(y) {}
+Point::Point(int x, int y): x_(CoordFromInt(x)), y_(CoordFromInt(y)) {}
+
+/* Returns the point at fixed point coordinates (x, y) */
+Point Point::FromCoord(Coord x, Coord y) {
+  Point result;
+  result.x_ = x;
+  result.y_ = y;
+  return result;
+}
 
 /* Returns this point translated by p */
 Point Point::Translate(const Point& p1, const Point& p2) {
-  return Point(p1.GetX() + p2.GetX(), p1.GetY() + p2.GetY());
+  return FromCoord(p1.x_ + p2.x_, p1.y_ + p2.y_);
 }
 
 /* Translate this point by p */
 Point& Point::Translate(const Point& p) {
-  x_ = x_ + p.GetX();
-  y_ = y_ + p.GetY();
+  x_ = x_ + p.x_;
+  y_ = y_ + p.y_;
   return *this;
 }
 
 /* Return this point scaled by scale factor with the specified pivot */
 Point Point::Scale(const Point& p, const Point& pivot, double scale_factor) {
-  return Point(pivot.GetX() + (p.GetX() - pivot.GetX()) * scale_factor,
-    pivot.GetY() + (p.GetY() - pivot.GetY()) * scale_factor);
+  return Point(p).Scale(pivot, scale_factor);
 }
 
 Point Point::Scale(const Point& p, const Point& pivot, double x_scale_factor, double y_scale_factor) {
-  return Point(pivot.GetX() + (p.GetX() - pivot.GetX()) * x_scale_factor,
-    pivot.GetY() + (p.GetY() - pivot.GetY()) * y_scale_factor);
+  return Point(p).Scale(pivot, x_scale_factor, y_scale_factor);
 }
 
 /* Scale this point by scale factor with the specified pivot */
 
 Point& Point::Scale(const Point& pivot, double scale_factor) {
-  x_ = pivot.GetX() + (x_ - pivot.GetX()) * scale_factor;
-  y_ = pivot.GetY() + (y_ - pivot.GetY()) * scale_factor;
-  return *this;
+  Factor factor = FactorFromDouble(scale_factor);
+  return ScaleFixed(pivot, factor, factor);
 }
 
 Point& Point::Scale(const Point& pivot, double x_scale_factor, double y_scale_factor) {
-  x_ = pivot.GetX() + (x_ - pivot.GetX()) * x_scale_factor;
-  y_ = pivot.GetY() + (y_ - pivot.GetY()) * y_scale_factor;
+  return ScaleFixed(pivot, FactorFromDouble(x_scale_factor), FactorFromDouble(y_scale_factor));
+}
+
+/* Scale this point by 16.16 fixed point factors with the specified pivot */
+Point& Point::ScaleFixed(const Point& pivot, Factor x_scale_factor, Factor y_scale_factor) {
+  x_ = pivot.x_ + MultiplyFactor(x_ - pivot.x_, x_scale_factor);
+  y_ = pivot.y_ + MultiplyFactor(y_ - pivot.y_, y_scale_factor);
   return *this;
 }
 
 /* Return p rotated by theta degree with the specified pivot */
 Point Point::Rotate(const Point& p, const Point& pivot, double theta) {
-  Point result;
-  double cos_theta, sin_theta;
-
-  cos_theta = std::cos(theta * PI / 180);
-  sin_theta = std::sin(theta * PI / 180);
-
-  int x = pivot.GetX() + (p.GetX() - pivot.GetX()) * cos_theta - (p.GetY() - pivot.GetY()) * sin_theta;
-  int y = pivot.GetY() + (p.GetY() - pivot.GetY()) * cos_theta + (p.GetX() - pivot.GetX()) * sin_theta;
-  result.SetX(x);
-  result.SetY(y);
-  return result;
+  return Point(p).Rotate(pivot, theta);
 }
 
 /* Rotate this point by thetha degree with the specified pivot */
 Point& Point::Rotate(const Point& pivot, double theta) {
-  double cos_theta, sin_theta;
-
-  cos_theta = std::cos(theta * PI / 180);
-  sin_theta = std::sin(theta * PI / 180);
-
-  int x = pivot.GetX() + (x_ - pivot.GetX()) * cos_theta - (y_ - pivot.GetY()) * sin_theta;
-  int y = pivot.GetY() + (y_ - pivot.GetY()) * cos_theta + (x_ - pivot.GetX()) * sin_theta;
+  Factor sin_theta;
+  Factor cos_theta;
+  Transform2D::SinCos(theta, &sin_theta, &cos_theta);
+  return RotateFixed(pivot, cos_theta, sin_theta);
+}
 
-  SetX(x);
-  SetY(y);
+/* Rotate this point by the angle of a 16.16 fixed point cosine and sine with the specified pivot */
+Point& Point::RotateFixed(const Point& pivot, Factor cos_theta, Factor sin_theta) {
+  int64_t dx = x_ - pivot.x_;
+  int64_t dy = y_ - pivot.y_;
+  x_ = pivot.x_ + (Coord) ((dx * cos_theta - dy * sin_theta + FACTOR_ONE / 2) >> FACTOR_SHIFT);
+  y_ = pivot.y_ + (Coord) ((dy * cos_theta + dx * sin_theta + FACTOR_ONE / 2) >> FACTOR_SHIFT);
   return *this;
 }
 
 /* Getter */
 int Point::GetX() const {
-  return x_;
+  return CoordToInt(x_);
 }
 
 int Point::GetY() const {
-  return y_;
+  return CoordToInt(y_);
 }
 
 /* Setter */
 void Point::SetX(int x) {
-  x_ = x;
+  x_ = CoordFromInt(x);
 }
 
 void Point::SetY(int y) {
-  y_ = y;
+  y_ = CoordFromInt(y);
 }
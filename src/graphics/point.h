@@ -3,12 +3,20 @@
 
  #define PI 3.14159265
 
+#include "fixed.h"
+
+/* A position with 1/256 pixel precision (24.8 fixed point). Transforms are
+integer multiply and shift, so repeating them does not drift, and the
+getters round to whole pixels for the rasterizer */
 class Point {
 public:
 	/* Constructor */
 	Point();
 	Point(int x, int y);
 
+	/* Returns the point at fixed point coordinates (x, y) */
+	static Point FromCoord(Coord x, Coord y);
+
 	/* Returns p1 translated by p2 */
 	static Point Translate(const Point& p1, const Point& p2);
 
@@ -23,23 +31,33 @@ public:
   Point& Scale(const Point& pivot, double scale_factor);
 	Point& Scale(const Point& pivot, double x_scale_factor, double y_scale_factor);
 
+	/* Scale this point by 16.16 fixed point factors with the specified pivot */
+	Point& ScaleFixed(const Point& pivot, Factor x_scale_factor, Factor y_scale_factor);
+
 	/* Return p rotated by theta degree with the specified pivot */
 	static Point Rotate(const Point& p, const Point& pivot, double theta);
 
 	/* Rotate this point by thetha degree with the specified pivot */
 	Point& Rotate(const Point& pivot, double theta);
 
-	/* Getter */
+	/* Rotate this point by the angle of a 16.16 fixed point cosine and sine with the specified pivot */
+	Point& RotateFixed(const Point& pivot, Factor cos_theta, Factor sin_theta);
+
+	/* Getter (nearest whole pixel) */
 	int GetX() const;
 	int GetY() const;
 
-	/* Setter */
+	/* Getter (fixed point) */
+	Coord GetCoordX() const { return x_; }
+	Coord GetCoordY() const { return y_; }
+
+	/* Setter (whole pixels) */
 	void SetX(int x);
 	void SetY(int y);
 
 private:
-	int x_; /* absis */
-	int y_; /* ordinat */
+	Coord x_; /* absis */
+	Coord y_; /* ordinat */
 };
 
 #endif
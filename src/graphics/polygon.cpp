@@ -1,89 +1,126 @@
 #include "polygon.h"
 
 /* Constructor */
-Polygon::Polygon() {}
+Polygon::Polygon() : is_edge_table_valid_(false), is_bounding_box_valid_(false) {}
 
 /* Getter */
 Point Polygon::GetPoint(int idx) const {
-  return points_[idx];
+  return Point::FromCoord(xs_[idx], ys_[idx]);
 }
 
 int Polygon::GetNumOfPoints() const {
-  return points_.size();
+  return xs_.size();
 }
 
-/* Translate this polygon */
-Polygon& Polygon::Translate(const Point &p) {
-  for (unsigned int i = 0; i < points_.size(); i++) {
-    points_[i].Translate(p);
+const Coord *Polygon::GetXs() const {
+  return xs_.data();
+}
+
+const Coord *Polygon::GetYs() const {
+  return ys_.data();
+}
+
+/* Edge table of this polygon, built on first use and kept until the points change */
+const EdgeTable& Polygon::GetEdgeTable() const {
+  if (!is_edge_table_valid_) {
+    edge_table_.Build(xs_.data(), ys_.data(), xs_.size());
+    is_edge_table_valid_ = true;
   }
+  return edge_table_;
+}
+
+/* Bounding box of this polygon, computed on first use and kept until the points change */
+const BoundingBox& Polygon::GetBoundingBox() const {
+  if (!is_bounding_box_valid_) {
+    bounding_box_ = BoundingBox::Of(xs_.data(), ys_.data(), xs_.size());
+    is_bounding_box_valid_ = true;
+  }
+  return bounding_box_;
+}
+
+/* Points and edges of this polygon, valid until the points change */
+PolygonShape Polygon::GetShape() const {
+  return MakeShape(xs_.data(), ys_.data(), xs_.size(), GetEdgeTable());
+}
+
+/* Shape of count points and the edge table built from them */
+PolygonShape Polygon::MakeShape(const Coord *xs, const Coord *ys, int count, const EdgeTable& edge_table) {
+  const std::vector<Edge>& edges = edge_table.GetEdges();
+  PolygonShape shape;
+  shape.xs = xs;
+  shape.ys = ys;
+  shape.point_count = count;
+  shape.edges = edges.empty() ? 0 : &edges[0];
+  shape.edge_count = edges.size();
+  shape.x_min = edge_table.GetXMin();
+  shape.x_max = edge_table.GetXMax();
+  shape.y_min = edge_table.GetYMin();
+  shape.y_max = edge_table.GetYMax();
+  return shape;
+}
+
+/* Move every point of this polygon by a transform */
+Polygon& Polygon::Transform(const Transform2D& transform) {
+  is_edge_table_valid_ = false;
+  is_bounding_box_valid_ = false;
+  transform.Apply(xs_.data(), ys_.data(), xs_.size(), xs_.data(), ys_.data());
   return *this;
 }
 
+/* Translate this polygon */
+Polygon& Polygon::Translate(const Point &p) {
+  return Transform(Transform2D::Translation(p));
+}
+
 /* Returns polygon translated by p */
 Polygon Polygon::Translate(const Polygon& polygon, const Point& p) {
-  Polygon result;
-  for (unsigned int i = 0; i < polygon.points_.size(); i++) {
-    result.AddPoint(Point::Translate(polygon.points_[i], p));
-  }
-  return result;
+  Polygon result = polygon;
+  return result.Translate(p);
 }
 
 /* Rotate this polygon */
 Polygon& Polygon::Rotate(const Point &pivot, double theta) {
-  for (unsigned int i = 0; i < points_.size(); i++) {
-    points_[i].Rotate(pivot, theta);
-  }
-  return *this;
+  return Transform(Transform2D::Rotation(pivot, theta));
 }
 
 
 /* Rotate this polygon */
 Polygon Polygon::Rotate(const Polygon& polygon, const Point &pivot, double theta) {
-  Polygon result;
-  for (unsigned int i = 0; i < polygon.points_.size(); i++) {
-    result.AddPoint(Point::Rotate(polygon.points_[i], pivot, theta));
-  }
-  return result;
+  Polygon result = polygon;
+  return result.Rotate(pivot, theta);
 }
 
 
 /* Scale this polygon */
 Polygon& Polygon::Scale(const Point &pivot, double scale_factor) {
-  for (unsigned int i = 0; i < points_.size(); i++) {
-    points_[i].Scale(pivot, scale_factor);
-  }
-  return *this;
+  return Scale(pivot, scale_factor, scale_factor);
 }
 Polygon& Polygon::Scale(const Point &pivot, double x_scale_factor, double y_scale_factor) {
-  for (unsigned int i = 0; i < points_.size(); i++) {
-    points_[i].Scale(pivot, x_scale_factor, y_scale_factor);
-  }
-  return *this;
+  return Transform(Transform2D::Scaling(pivot, x_scale_factor, y_scale_factor));
 }
 
 	/* Returns the scaled polygon */
 Polygon Polygon::Scale(const Polygon& polygon, const Point &pivot, double scale_factor) {
-  Polygon result;
-  for (unsigned int i = 0; i < polygon.points_.size(); i++) {
-    result.AddPoint(Point::Scale(polygon.points_[i], pivot, scale_factor));
-  }
-  return result;
+  Polygon result = polygon;
+  return result.Scale(pivot, scale_factor);
 }
 
 Polygon Polygon::Scale(const Polygon& polygon, const Point &pivot, double x_scale_factor, double y_scale_factor) {
-  Polygon result;
-  for (unsigned int i = 0; i < polygon.points_.size(); i++) {
-    result.AddPoint(Point::Scale(polygon.points_[i], pivot, x_scale_factor, y_scale_factor));
-  }
-  return result;
+  Polygon result = polygon;
+  return result.Scale(pivot, x_scale_factor, y_scale_factor);
 }
 
 /* Setter */
 void Polygon::AddPoint(const Point& point) {
-  points_.push_back(point);
+  is_edge_table_valid_ = false;
+  is_bounding_box_valid_ = false;
+  xs_.push_back(point.GetCoordX());
+  ys_.push_back(point.GetCoordY());
 }
 
 void Polygon::SetPoint(const Point& point, int idx) {
-  points_[idx] = point;
+  is_edge_table_valid_ = false;
+  is_bounding_box_valid_ = false;
+  xs_[idx] = point.GetCoordX();
+  ys_[idx] = point.GetCoordY();
 }
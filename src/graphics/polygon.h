@@ -2,8 +2,32 @@
 #define POLYGON_H
 
 #include "point.h"
+#include "edge_table.h"
+#include "transform.h"
+#include "aligned_allocator.h"
+#include "bounding_box.h"
 #include <vector>
 
+/* Coordinate arrays start on a 32 byte boundary, a whole AVX2 register */
+#define COORD_ALIGNMENT 32
+
+/* Coordinates of the points of a polygon, one array per axis */
+typedef std::vector<Coord, AlignedAllocator<Coord, COORD_ALIGNMENT> > CoordArray;
+
+/* Points, edges and bounding box of a polygon, pointing into storage owned by
+a Polygon or a CommandBuffer */
+struct PolygonShape {
+  const Coord *xs; /* x of every point (24.8 fixed point) */
+  const Coord *ys;
+  int point_count;
+  const Edge *edges;
+  int edge_count;
+  int x_min;
+  int x_max;
+  int y_min;
+  int y_max;
+};
+
 class Polygon {
 public:
 	/* Constructor */
@@ -13,6 +37,26 @@ public:
   Point GetPoint(int idx) const;
   int GetNumOfPoints() const;
 
+  /* x and y of every point (24.8 fixed point), GetNumOfPoints() long and valid
+  until points are added */
+  const Coord *GetXs() const;
+  const Coord *GetYs() const;
+
+  /* Edge table of this polygon, built on first use and kept until the points change */
+  const EdgeTable& GetEdgeTable() const;
+
+  /* Bounding box of this polygon, computed on first use and kept until the points change */
+  const BoundingBox& GetBoundingBox() const;
+
+  /* Points and edges of this polygon, valid until the points change */
+  PolygonShape GetShape() const;
+
+  /* Shape of count points and the edge table built from them */
+  static PolygonShape MakeShape(const Coord *xs, const Coord *ys, int count, const EdgeTable& edge_table);
+
+	/* Move every point of this polygon by a transform */
+	Polygon& Transform(const Transform2D& transform);
+
 	/* Translate this polygon */
 	Polygon& Translate(const Point &p);
 
@@ -38,8 +82,14 @@ public:
 	void SetPoint(const Point& point, int idx);
 
 private:
-  /* Notes: the lines creating the polygon are consist of ordered points*/
-	std::vector<Point> points_;
+  /* Notes: the lines creating the polygon are consist of ordered points,
+  stored as one array per axis */
+	CoordArray xs_;
+	CoordArray ys_;
+	mutable EdgeTable edge_table_;
+	mutable bool is_edge_table_valid_;
+	mutable BoundingBox bounding_box_;
+	mutable bool is_bounding_box_valid_;
 };
 
 #endif
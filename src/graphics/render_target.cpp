@@ -0,0 +1,33 @@
+#include "render_target.h"
+#include "pixel_format.h"
+#include <stdio.h>
+
+/* Save the presented frame as a binary PPM (P6) image */
+bool RenderTarget::SaveAsPPM(const char *file_path) const {
+  FILE *ppm_file = fopen(file_path, "wb");
+  if (!ppm_file) {
+    perror("Error: failed to open ppm file");
+    return false;
+  }
+
+  fprintf(ppm_file, "P6\n%ld %ld\n255\n", width_, height_);
+  int bytes_per_pixel = bits_per_pixel_ / 8;
+  for (long y = 0; y < height_; y++) {
+    const uint8_t *row = memory_ + (y_offset_ + y) * line_length_;
+    for (long x = 0; x < width_; x++) {
+      const uint8_t *pixel = row + x * bytes_per_pixel;
+      Color color;
+      if (bits_per_pixel_ == 16) {
+        color = PixelRGB565::Unpack(pixel);
+      } else {
+        color = PixelRGB888::Unpack(pixel);
+      }
+      uint8_t rgb[3] = {color.GetR(), color.GetG(), color.GetB()};
+      fwrite(rgb, 1, sizeof(rgb), ppm_file);
+    }
+  }
+
+  bool success = !ferror(ppm_file);
+  fclose(ppm_file);
+  return success;
+}
@@ -0,0 +1,43 @@
+#ifndef RENDER_TARGET_H
+#define RENDER_TARGET_H
+
+#include <stdint.h>
+
+/* A block of pixel memory that a Framebuffer presents its frames into */
+class RenderTarget {
+public:
+  /* Destructor */
+  virtual ~RenderTarget() {}
+
+  /* Show the rows starting at y_offset of the virtual screen, returns false if
+  the target cannot pan */
+  virtual bool Pan(long y_offset) { return y_offset == y_offset_; }
+
+  /* Save the presented frame as a binary PPM (P6) image */
+  bool SaveAsPPM(const char *file_path) const;
+
+  /* Getter */
+  uint8_t *GetMemory() const { return memory_; }
+  long GetMemorySize() const { return memory_size_; }
+  long GetWidth() const { return width_; }
+  long GetHeight() const { return height_; }
+  long GetVirtualHeight() const { return virtual_height_; }
+  int GetLineLength() const { return line_length_; }
+  int GetBitsPerPixel() const { return bits_per_pixel_; }
+  long GetYOffset() const { return y_offset_; }
+
+protected:
+  /* Constructor */
+  RenderTarget() : memory_(0), memory_size_(0), width_(0), height_(0), virtual_height_(0), y_offset_(0), line_length_(0), bits_per_pixel_(0) {}
+
+  uint8_t *memory_; /* pointer to screen memory */
+  long memory_size_;
+  long width_;
+  long height_;
+  long virtual_height_;
+  long y_offset_; /* first visible row of the virtual screen */
+  int line_length_; /* bytes per row */
+  int bits_per_pixel_;
+};
+
+#endif
@@ -0,0 +1,101 @@
+#include "spatial_grid.h"
+#include <algorithm>
+#include <cmath>
+
+/* Constructor (empty grid) */
+SpatialGrid::SpatialGrid() : x_origin_(0), y_origin_(0), cell_width_(1), cell_height_(1), columns_(0), rows_(0) {}
+
+/* Rebuild the grid over the count boxes */
+void SpatialGrid::Build(const BoundingBox *boxes, int count) {
+  cell_starts_.clear();
+  items_.clear();
+  columns_ = rows_ = 0;
+
+  BoundingBox area;
+  for (int i = 0; i < count; i++) {
+    area.Add(boxes[i]);
+  }
+  if (area.IsEmpty()) {
+    return;
+  }
+
+  /* About as many cells as boxes, square in pixels */
+  int width = area.GetXMax() - area.GetXMin() + 1;
+  int height = area.GetYMax() - area.GetYMin() + 1;
+  int cell_size = std::max(1, (int) ceil(sqrt((double) width * height / count)));
+  x_origin_ = area.GetXMin();
+  y_origin_ = area.GetYMin();
+  cell_width_ = cell_height_ = cell_size;
+  columns_ = (width + cell_size - 1) / cell_size;
+  rows_ = (height + cell_size - 1) / cell_size;
+
+  /* Count the boxes of every cell, then place them (counting sort) */
+  cell_starts_.assign(columns_ * rows_ + 1, 0);
+  for (int pass = 0; pass < 2; pass++) {
+    for (int i = 0; i < count; i++) {
+      if (boxes[i].IsEmpty()) {
+        continue;
+      }
+      int first_column = GetColumn(boxes[i].GetXMin());
+      int last_column = GetColumn(boxes[i].GetXMax());
+      int first_row = GetRow(boxes[i].GetYMin());
+      int last_row = GetRow(boxes[i].GetYMax());
+      for (int row = first_row; row <= last_row; row++) {
+        for (int column = first_column; column <= last_column; column++) {
+          int cell = row * columns_ + column;
+          if (pass == 0) {
+            cell_starts_[cell + 1]++;
+          } else {
+            items_[cell_starts_[cell]++] = i;
+          }
+        }
+      }
+    }
+    if (pass == 0) {
+      for (int cell = 0; cell < columns_ * rows_; cell++) {
+        cell_starts_[cell + 1] += cell_starts_[cell];
+      }
+      items_.resize(cell_starts_[columns_ * rows_]);
+    } else {
+      /* Placing moved every start to the start of the next cell */
+      for (int cell = columns_ * rows_; cell > 0; cell--) {
+        cell_starts_[cell] = cell_starts_[cell - 1];
+      }
+      cell_starts_[0] = 0;
+    }
+  }
+}
+
+/* Replace result by the ascending indices of the boxes near a rectangle */
+void SpatialGrid::Query(const Point& top_left, const Point& bottom_right, std::vector<int>& result) const {
+  result.clear();
+  if (columns_ == 0 ||
+      bottom_right.GetX() < x_origin_ || top_left.GetX() >= x_origin_ + columns_ * cell_width_ ||
+      bottom_right.GetY() < y_origin_ || top_left.GetY() >= y_origin_ + rows_ * cell_height_) {
+    return;
+  }
+
+  int first_column = GetColumn(top_left.GetX());
+  int last_column = GetColumn(bottom_right.GetX());
+  int first_row = GetRow(top_left.GetY());
+  int last_row = GetRow(bottom_right.GetY());
+  for (int row = first_row; row <= last_row; row++) {
+    const int *first = items_.data() + cell_starts_[row * columns_ + first_column];
+    const int *last = items_.data() + cell_starts_[row * columns_ + last_column + 1];
+    result.insert(result.end(), first, last);
+  }
+
+  /* Boxes spanning several cells are listed once per cell, and callers draw
+  in index order */
+  std::sort(result.begin(), result.end());
+  result.erase(std::unique(result.begin(), result.end()), result.end());
+}
+
+/* Cell column or row of a pixel, clamped to the grid */
+int SpatialGrid::GetColumn(int x) const {
+  return std::min(columns_ - 1, std::max(0, (x - x_origin_) / cell_width_));
+}
+
+int SpatialGrid::GetRow(int y) const {
+  return std::min(rows_ - 1, std::max(0, (y - y_origin_) / cell_height_));
+}
@@ -0,0 +1,42 @@
+#ifndef SPATIAL_GRID_H
+#define SPATIAL_GRID_H
+
+#include "bounding_box.h"
+#include "point.h"
+#include <vector>
+
+/* Static index of a set of boxes: the area they cover is cut into a uniform
+grid of cells, each listing the boxes that overlap it, so that a rectangle
+query only reads the cells it covers */
+class SpatialGrid {
+public:
+  /* Constructor (empty grid) */
+  SpatialGrid();
+
+  /* Rebuild the grid over the count boxes, roughly one cell per box */
+  void Build(const BoundingBox *boxes, int count);
+
+  /* Replace result by the ascending indices of the boxes overlapping a cell
+  covered by the rectangle from top_left to bottom_right. It may hold boxes
+  outside the rectangle, never misses one inside it */
+  void Query(const Point& top_left, const Point& bottom_right, std::vector<int>& result) const;
+
+private:
+  /* Cell column or row of a pixel, clamped to the grid */
+  int GetColumn(int x) const;
+  int GetRow(int y) const;
+
+  int x_origin_;
+  int y_origin_;
+  int cell_width_;
+  int cell_height_;
+  int columns_;
+  int rows_;
+
+  /* Boxes of cell (column, row) are items_[cell_starts_[i]] up to
+  items_[cell_starts_[i + 1]], with i = row * columns_ + column */
+  std::vector<int> cell_starts_;
+  std::vector<int> items_;
+};
+
+#endif
@@ -1,19 +1,27 @@
 #include "sprite.h"
+#include "outline_simplifier.h"
+#include <algorithm>
+#include <cmath>
 #include <fstream>
 #include <iostream>
 #include <sstream>
 
 /* Constructor */
-Sprite::Sprite(const char *sprite_path) {
+Sprite::Sprite() : geometry_(std::make_shared<Geometry>()) {}
+
+Sprite::Sprite(const std::shared_ptr<Geometry>& geometry) : geometry_(geometry) {}
+
+Sprite::Sprite(const char *sprite_path) : geometry_(std::make_shared<Geometry>()) {
   std::ifstream sprite_file;
   char ignore_character;
+  Geometry& geometry = *geometry_;
 
   sprite_file.open(sprite_path);
   if (sprite_file.is_open()) {
     int polygon_count;
     sprite_file >> polygon_count;
     for (int i = 0; i < polygon_count; i++) {
-      Polygon polygon;
+      SpritePolygon polygon;
       double dx, dy;
       double acc_x = 0.0;
       double acc_y = 0.0;
@@ -25,6 +33,7 @@ Sprite::Sprite(const char *sprite_path) {
       sprite_file >> border_r >> border_g >> border_b;
       sprite_file.ignore();
 
+      polygon.first_point = geometry.xs.size();
       for (int j = 0; j < count; j++) {
         std::string line;
         std::getline(sprite_file, line);
@@ -32,25 +41,192 @@ Sprite::Sprite(const char *sprite_path) {
         while(closed_path >> dx >> ignore_character >> dy) {
           acc_x += dx;
           acc_y += dy;
-          polygon.AddPoint(Point(acc_x, acc_y));
+          geometry.xs.push_back(CoordFromDouble(acc_x));
+          geometry.ys.push_back(CoordFromDouble(acc_y));
         }
       }
-      polygons_.push_back(polygon);
-      fill_colors_.push_back(Color(fill_r, fill_g, fill_b));
-      border_colors_.push_back(Color(border_r, border_g, border_b));
+      polygon.point_count = geometry.xs.size() - polygon.first_point;
+      polygon.fill_color = Color(fill_r, fill_g, fill_b);
+      polygon.border_color = Color(border_r, border_g, border_b);
+      geometry.polygons.push_back(polygon);
     }
     sprite_file.close();
   }
 }
 
-/* Translate this sprite */
-Sprite& Sprite::Translate(const Point &p) {
-  for (unsigned int i = 0; i < polygons_.size(); i++) {
-    polygons_[i].Translate(p);
+/* Getter */
+int Sprite::GetPolygonCount() const {
+  return geometry_->polygons.size();
+}
+
+const SpritePolygon& Sprite::GetPolygon(int idx) const {
+  return geometry_->polygons[idx];
+}
+
+const SpritePolygon *Sprite::GetPolygons() const {
+  return geometry_->polygons.data();
+}
+
+int Sprite::GetNumOfPoints() const {
+  return geometry_->xs.size();
+}
+
+const Coord *Sprite::GetXs() const {
+  return geometry_->xs.data();
+}
+
+const Coord *Sprite::GetYs() const {
+  return geometry_->ys.data();
+}
+
+/* Points, edges and bounding box of every polygon, built on first use */
+const PolygonShape *Sprite::GetShapes() const {
+  const Geometry& geometry = *geometry_;
+  if (!geometry.is_shapes_valid) {
+    int count = geometry.polygons.size();
+    std::vector<int> first_edges(count);
+    EdgeTable edge_table;
+    geometry.edges.clear();
+    geometry.shapes.resize(count);
+    for (int i = 0; i < count; i++) {
+      const SpritePolygon& polygon = geometry.polygons[i];
+      const Coord *xs = geometry.xs.data() + polygon.first_point;
+      const Coord *ys = geometry.ys.data() + polygon.first_point;
+      edge_table.Build(xs, ys, polygon.point_count);
+      geometry.shapes[i] = Polygon::MakeShape(xs, ys, polygon.point_count, edge_table);
+      first_edges[i] = geometry.edges.size();
+      geometry.edges.insert(geometry.edges.end(), edge_table.GetEdges().begin(), edge_table.GetEdges().end());
+    }
+
+    /* Point the shapes at the edge array once it stopped growing */
+    for (int i = 0; i < count; i++) {
+      geometry.shapes[i].edges = geometry.edges.data() + first_edges[i];
+    }
+    geometry.is_shapes_valid = true;
+  }
+  return geometry.shapes.data();
+}
+
+/* Bounding box of the whole sprite and of one polygon */
+const BoundingBox& Sprite::GetBoundingBox() const {
+  UpdateBoundingBoxes();
+  return geometry_->box;
+}
+
+const BoundingBox& Sprite::GetBoundingBox(int idx) const {
+  UpdateBoundingBoxes();
+  return geometry_->polygon_boxes[idx];
+}
+
+const BoundingBox *Sprite::GetBoundingBoxes() const {
+  UpdateBoundingBoxes();
+  return geometry_->polygon_boxes.data();
+}
+
+/* Ascending indices of the polygons that may reach a rectangle */
+void Sprite::FindPolygons(const Point& top_left, const Point& bottom_right, std::vector<int>& polygons) const {
+  UpdateBoundingBoxes();
+  const Geometry& geometry = *geometry_;
+  if (!geometry.is_grid_valid) {
+    geometry.grid.Build(geometry.polygon_boxes.data(), geometry.polygon_boxes.size());
+    geometry.is_grid_valid = true;
+  }
+  geometry.grid.Query(top_left, bottom_right, polygons);
+}
+
+/* This sprite at a level of detail */
+Sprite Sprite::GetLevelOfDetail(int level) const {
+  const Geometry& geometry = *geometry_;
+  if (level <= 0) {
+    return *this;
+  }
+  if (geometry.levels.empty()) {
+    /* Every level simplifies the sprite itself, so that its error stays
+    within its own tolerance */
+    const Geometry *source = &geometry;
+    double tolerance = LOD_TOLERANCE;
+    for (int i = 1; i < LOD_LEVELS; i++) {
+      std::shared_ptr<Geometry> simplified = std::make_shared<Geometry>();
+      for (unsigned int j = 0; j < source->polygons.size(); j++) {
+        SpritePolygon polygon = source->polygons[j];
+        const Coord *xs = source->xs.data() + polygon.first_point;
+        const Coord *ys = source->ys.data() + polygon.first_point;
+        polygon.first_point = simplified->xs.size();
+        polygon.point_count = OutlineSimplifier::Simplify(xs, ys, polygon.point_count, CoordFromDouble(tolerance), simplified->xs, simplified->ys);
+        simplified->polygons.push_back(polygon);
+      }
+      geometry.levels.push_back(simplified);
+      tolerance *= 2;
+    }
+  }
+  return Sprite(geometry.levels[std::min(level, LOD_LEVELS - 1) - 1]);
+}
+
+/* The coarsest level of detail for a scale */
+int Sprite::GetLevelOfDetailFor(double scale) {
+  int level = 0;
+  while (level + 1 < LOD_LEVELS && LOD_TOLERANCE * (1 << level) * fabs(scale) <= 0.5) {
+    level++;
   }
+  return level;
+}
+
+/* Compute the boxes of the geometry if they are not valid */
+void Sprite::UpdateBoundingBoxes() const {
+  const Geometry& geometry = *geometry_;
+  if (!geometry.is_boxes_valid) {
+    geometry.polygon_boxes.resize(geometry.polygons.size());
+    geometry.box = BoundingBox();
+    for (unsigned int i = 0; i < geometry.polygons.size(); i++) {
+      const SpritePolygon& polygon = geometry.polygons[i];
+      geometry.polygon_boxes[i] = BoundingBox::Of(geometry.xs.data() + polygon.first_point, geometry.ys.data() + polygon.first_point, polygon.point_count);
+      geometry.box.Add(geometry.polygon_boxes[i]);
+    }
+    geometry.is_boxes_valid = true;
+  }
+}
+
+/* Append a polygon */
+void Sprite::AddPolygon(const Polygon& polygon, const Color& fill_color, const Color& border_color) {
+  Geometry& geometry = Edit();
+  SpritePolygon entry;
+  entry.first_point = geometry.xs.size();
+  entry.point_count = polygon.GetNumOfPoints();
+  entry.fill_color = fill_color;
+  entry.border_color = border_color;
+  geometry.xs.insert(geometry.xs.end(), polygon.GetXs(), polygon.GetXs() + entry.point_count);
+  geometry.ys.insert(geometry.ys.end(), polygon.GetYs(), polygon.GetYs() + entry.point_count);
+  geometry.polygons.push_back(entry);
+}
+
+/* Move every point of this sprite by a transform, all polygons in one pass */
+Sprite& Sprite::Transform(const Transform2D& transform) {
+  Geometry& geometry = Edit();
+  transform.Apply(geometry.xs.data(), geometry.ys.data(), geometry.xs.size(), geometry.xs.data(), geometry.ys.data());
   return *this;
 }
 
+/* Give this sprite its own copy of the geometry before it changes */
+Sprite::Geometry& Sprite::Edit() {
+  if (geometry_.use_count() > 1) {
+    std::shared_ptr<Geometry> copy = std::make_shared<Geometry>();
+    copy->xs = geometry_->xs;
+    copy->ys = geometry_->ys;
+    copy->polygons = geometry_->polygons;
+    geometry_ = copy;
+  }
+  geometry_->is_shapes_valid = false;
+  geometry_->is_boxes_valid = false;
+  geometry_->is_grid_valid = false;
+  geometry_->levels.clear();
+  return *geometry_;
+}
+
+/* Translate this sprite */
+Sprite& Sprite::Translate(const Point &p) {
+  return Transform(Transform2D::Translation(p));
+}
+
 /* Return sprite translated by p */
 Sprite Sprite::Translate(const Sprite& sprite, const Point& p) {
   Sprite result = sprite;
@@ -59,10 +235,7 @@ Sprite Sprite::Translate(const Sprite& sprite, const Point& p) {
 
 /* Rotate this sprite */
 Sprite& Sprite::Rotate(const Point &pivot, double theta) {
-  for (unsigned int i = 0; i < polygons_.size(); i++) {
-    polygons_[i].Rotate(pivot, theta);
-  }
-  return *this;
+  return Transform(Transform2D::Rotation(pivot, theta));
 }
 
 /* Rotate this sprite */
@@ -73,16 +246,10 @@ Sprite Sprite::Rotate(const Sprite& sprite, const Point &pivot, double theta) {
 
 /* Scale this sprite */
 Sprite& Sprite::Scale(const Point &pivot, double scale_factor) {
-  for (unsigned int i = 0; i < polygons_.size(); i++) {
-    polygons_[i].Scale(pivot, scale_factor);
-  }
-  return *this;
+  return Transform(Transform2D::Scaling(pivot, scale_factor));
 }
 Sprite& Sprite::Scale(const Point &pivot, double x_scale_factor, double y_scale_factor) {
-  for (unsigned int i = 0; i < polygons_.size(); i++) {
-    polygons_[i].Scale(pivot, x_scale_factor, y_scale_factor);
-  }
-  return *this;
+  return Transform(Transform2D::Scaling(pivot, x_scale_factor, y_scale_factor));
 }
 
 /* Return the scaled sprite */
@@ -2,15 +2,77 @@
 #define SPRITE_H
 
 #include "polygon.h"
+#include "edge_table.h"
+#include "bounding_box.h"
+#include "spatial_grid.h"
+#include "transform.h"
 #include "color.h"
+#include <memory>
 #include <vector>
 
+/* Levels of detail of a sprite: level 0 is the sprite itself, level i drops
+the points within LOD_TOLERANCE * 2^(i - 1) pixels of its simplified outlines */
+#define LOD_LEVELS 4
+#define LOD_TOLERANCE 0.5
+
+/* A polygon of a sprite: its points are point_count long from first_point in
+the coordinate arrays of the sprite */
+struct SpritePolygon {
+  int first_point;
+  int point_count;
+  Color fill_color;
+  Color border_color;
+};
+
+/* Polygons drawn in order. Every vertex of the sprite is stored in one pair of
+coordinate arrays, and copies of a sprite share them until one of the copies
+changes (copy on write), so copying a sprite does not allocate */
 class Sprite {
 public:
 	/* Constructor */
-	Sprite() {}
+	Sprite();
 	Sprite(const char *sprite_path);
 
+	/* Getter */
+	int GetPolygonCount() const;
+	const SpritePolygon& GetPolygon(int idx) const;
+	const SpritePolygon *GetPolygons() const; /* GetPolygonCount() long */
+	int GetNumOfPoints() const; /* of every polygon */
+
+	/* x and y of every point of every polygon (24.8 fixed point), see SpritePolygon */
+	const Coord *GetXs() const;
+	const Coord *GetYs() const;
+
+	/* Points, edges and bounding box of every polygon, built on first use and
+	valid until this sprite changes */
+	const PolygonShape *GetShapes() const;
+
+	/* Bounding box of the whole sprite and of one polygon, computed on first
+	use and kept until this sprite changes */
+	const BoundingBox& GetBoundingBox() const;
+	const BoundingBox& GetBoundingBox(int idx) const;
+	const BoundingBox *GetBoundingBoxes() const; /* GetPolygonCount() long */
+
+	/* Replace polygons by the ascending indices of the polygons that may reach
+	the rectangle from top_left to bottom_right, read from a grid over the
+	polygon boxes built on first use and kept until this sprite changes */
+	void FindPolygons(const Point& top_left, const Point& bottom_right, std::vector<int>& polygons) const;
+
+	/* This sprite at a level of detail (see LOD_LEVELS), with the same
+	polygons and colors. The levels are built together on first use and kept
+	until this sprite changes, and the returned copy shares them */
+	Sprite GetLevelOfDetail(int level) const;
+
+	/* The coarsest level of detail that moves no outline by more than half a
+	pixel when the sprite is drawn scaled by scale */
+	static int GetLevelOfDetailFor(double scale);
+
+	/* Append a polygon */
+	void AddPolygon(const Polygon& polygon, const Color& fill_color, const Color& border_color);
+
+	/* Move every point of this sprite by a transform */
+	Sprite& Transform(const Transform2D& transform);
+
 	/* Translate this sprite */
 	Sprite& Translate(const Point &p);
 
@@ -32,9 +94,44 @@ public:
 	static Sprite Scale(const Sprite& sprite, const Point &pivot, double scale_factor);
 	static Sprite Scale(const Sprite& sprite, const Point &pivot, double x_scale_factor, double y_scale_factor);
 
-  std::vector<Polygon> polygons_;
-  std::vector<Color> fill_colors_;
-  std::vector<Color> border_colors_;
+private:
+	/* Storage shared by the copies of a sprite */
+	struct Geometry {
+		CoordArray xs;
+		CoordArray ys;
+		std::vector<SpritePolygon> polygons;
+
+		/* Edge tables of every polygon in one array, built on first use */
+		mutable std::vector<Edge> edges;
+		mutable std::vector<PolygonShape> shapes;
+		mutable bool is_shapes_valid;
+
+		/* Boxes of every polygon and of the whole sprite, computed on first use */
+		mutable std::vector<BoundingBox> polygon_boxes;
+		mutable BoundingBox box;
+		mutable bool is_boxes_valid;
+
+		/* Index over the polygon boxes, built on first use */
+		mutable SpatialGrid grid;
+		mutable bool is_grid_valid;
+
+		/* Geometry of levels of detail 1 and up, built on first use */
+		mutable std::vector<std::shared_ptr<Geometry> > levels;
+
+		Geometry() : is_shapes_valid(false), is_boxes_valid(false), is_grid_valid(false) {}
+	};
+
+	/* Give this sprite its own copy of the geometry before it changes, and
+	drop the cached edges, boxes, grid and levels of detail */
+	Geometry& Edit();
+
+	/* Sprite sharing geometry */
+	explicit Sprite(const std::shared_ptr<Geometry>& geometry);
+
+	/* Compute the boxes of the geometry if they are not valid */
+	void UpdateBoundingBoxes() const;
+
+	std::shared_ptr<Geometry> geometry_;
 };
 
 #endif
@@ -0,0 +1,251 @@
+#include "tile_pyramid.h"
+#include <algorithm>
+#include <cmath>
+
+/* Tile holding level pixel p */
+static int TileOf(int64_t p) {
+  return p >= 0 ? p / TILE_SIZE : -((-p + TILE_SIZE - 1) / TILE_SIZE);
+}
+
+/* Constructor (no sources) */
+TilePyramid::TilePyramid() : tile_count_(0), draw_count_(0) {}
+
+/* Destructor */
+TilePyramid::~TilePyramid() {
+  Invalidate();
+}
+
+/* Add a sprite drawn into the tiles */
+void TilePyramid::AddSource(const Sprite *sprite) {
+  sources_.push_back(sprite);
+  Invalidate();
+}
+
+/* Drop every source and tile */
+void TilePyramid::Reset() {
+  sources_.clear();
+  Invalidate();
+}
+
+/* Drop every tile */
+void TilePyramid::Invalidate() {
+  for (unsigned int i = 0; i < levels_.size(); i++) {
+    for (unsigned int j = 0; j < levels_[i].tiles.size(); j++) {
+      delete levels_[i].tiles[j].layer;
+    }
+  }
+  levels_.clear();
+  tile_count_ = 0;
+}
+
+/* Draw the sources scaled from the tiles of the nearest finer level */
+bool TilePyramid::Draw(Framebuffer& fb, const Point& source_top_left, double x_scale, double y_scale, const Point& top_left, const Point& bottom_right) {
+  if (x_scale <= 0 || y_scale <= 0) {
+    return false;
+  }
+
+  /* Shrinking a finer level keeps the detail, enlarging a coarser one would not */
+  double scale = std::max(x_scale, y_scale);
+  int level = TILE_MIN_LEVEL;
+  while (level <= TILE_MAX_LEVEL && ldexp(1.0, level) < scale * (1 - 1e-9)) {
+    level++;
+  }
+  if (level > TILE_MAX_LEVEL) {
+    return false;
+  }
+  if (levels_.empty()) {
+    BuildLevels();
+  }
+  draw_count_++;
+
+  /* Pixel x of the view samples the level pixel nearest to source point
+  source_top_left.x + (x - top_left.x) / x_scale, and y likewise */
+  Level& grid = levels_[level - TILE_MIN_LEVEL];
+  double level_scale = ldexp(1.0, level);
+  int64_t u_step = llrint(level_scale / x_scale * 65536);
+  int64_t v_step = llrint(level_scale / y_scale * 65536);
+  int64_t u_first = (int64_t) floor(source_top_left.GetX() * level_scale * 65536 + 32768);
+  int64_t v_first = (int64_t) floor(source_top_left.GetY() * level_scale * 65536 + 32768);
+  SplitRuns(top_left.GetX(), bottom_right.GetX(), u_first, u_step, column_runs_);
+  SplitRuns(top_left.GetY(), bottom_right.GetY(), v_first, v_step, row_runs_);
+
+  int warmed = 0;
+  for (unsigned int i = 0; i < row_runs_.size(); i++) {
+    const TileRun& row_run = row_runs_[i];
+    int row = row_run.tile - grid.first_row;
+    if (row < 0 || row >= grid.rows) {
+      continue;
+    }
+    for (unsigned int j = 0; j < column_runs_.size(); j++) {
+      const TileRun& column_run = column_runs_[j];
+      int column = column_run.tile - grid.first_column;
+      if (column < 0 || column >= grid.columns) {
+        continue;
+      }
+      Point run_top_left(column_run.first, row_run.first);
+      Point run_bottom_right(column_run.last, row_run.last);
+      Tile& tile = grid.tiles[row * grid.columns + column];
+
+      /* Cold tiles past the warm limit are drawn from the sources this time */
+      if (!tile.layer) {
+        if (warmed == TILE_WARM_LIMIT || !WarmTile(level, tile, column_run.tile, row_run.tile)) {
+          DrawRun(fb, source_top_left, x_scale, y_scale, top_left, run_top_left, run_bottom_right);
+          continue;
+        }
+        warmed++;
+      }
+      tile.last_used = draw_count_;
+
+      /* Only the part of the run that samples what was drawn into the tile */
+      int x_first = column_run.first;
+      int x_last = column_run.last;
+      int y_first = row_run.first;
+      int y_last = row_run.last;
+      int64_t u = column_run.u - (int64_t) column_run.tile * TILE_SIZE * 65536;
+      int64_t v = row_run.u - (int64_t) row_run.tile * TILE_SIZE * 65536;
+      if (ClipRun(x_first, x_last, u, u_step, tile.x_min, tile.x_max) && ClipRun(y_first, y_last, v, v_step, tile.y_min, tile.y_max)) {
+        fb.CompositeLayer(*tile.layer, Point(x_first, y_first), Point(x_last, y_last), u, v, u_step, v_step);
+      }
+    }
+  }
+  return true;
+}
+
+/* Draw the part of a view from run_top_left to run_bottom_right from the sources */
+void TilePyramid::DrawRun(Framebuffer& fb, const Point& source_top_left, double x_scale, double y_scale, const Point& top_left, const Point& run_top_left, const Point& run_bottom_right) {
+  Transform2D transform = Transform2D::Scaling(source_top_left, x_scale, y_scale).Then(
+    Transform2D::Translation(Point(top_left.GetX() - source_top_left.GetX(), top_left.GetY() - source_top_left.GetY())));
+
+  /* The source rectangle of the run, with the margin View::Render uses */
+  int x_margin = (int) ceil(1.0 / x_scale) + 1;
+  int y_margin = (int) ceil(1.0 / y_scale) + 1;
+  Point query_top_left((int) floor(source_top_left.GetX() + (run_top_left.GetX() - top_left.GetX()) / x_scale) - x_margin,
+                       (int) floor(source_top_left.GetY() + (run_top_left.GetY() - top_left.GetY()) / y_scale) - y_margin);
+  Point query_bottom_right((int) ceil(source_top_left.GetX() + (run_bottom_right.GetX() - top_left.GetX()) / x_scale) + x_margin,
+                           (int) ceil(source_top_left.GetY() + (run_bottom_right.GetY() - top_left.GetY()) / y_scale) + y_margin);
+  DrawSources(fb, transform, std::max(x_scale, y_scale), query_top_left, query_bottom_right, run_top_left, run_bottom_right);
+}
+
+/* Getter */
+int TilePyramid::GetTileCount() const {
+  return tile_count_;
+}
+
+/* Cut pixels into runs of the same tile */
+void TilePyramid::SplitRuns(int first, int last, int64_t u_first, int64_t step, std::vector<TileRun>& runs) {
+  runs.clear();
+  int64_t u = u_first;
+  for (int x = first; x <= last; x++) {
+    int tile = TileOf(u >> 16);
+    if (runs.empty() || runs.back().tile != tile) {
+      TileRun run;
+      run.first = x;
+      run.tile = tile;
+      run.u = u;
+      runs.push_back(run);
+    }
+    runs.back().last = x;
+    u += step;
+  }
+}
+
+/* Shrink a run to the pixels sampling tile pixels from low to high */
+bool TilePyramid::ClipRun(int& first, int& last, int64_t& u, int64_t step, int low, int high) {
+  if (low > high) {
+    return false;
+  }
+
+  /* Pixels skipped before sampling low, and pixels up to the last one sampling high */
+  int64_t skipped = std::max<int64_t>(0, (((int64_t) low << 16) - u + step - 1) / step);
+  int64_t kept = (((int64_t) (high + 1) << 16) - u + step - 1) / step;
+  if (first + kept - 1 < last) {
+    last = first + kept - 1;
+  }
+  first += skipped;
+  u += skipped * step;
+  return first <= last;
+}
+
+/* Lay out the tile grids of every level over the sources */
+void TilePyramid::BuildLevels() {
+  BoundingBox box;
+  for (unsigned int i = 0; i < sources_.size(); i++) {
+    box.Add(sources_[i]->GetBoundingBox());
+  }
+
+  levels_.resize(TILE_MAX_LEVEL - TILE_MIN_LEVEL + 1);
+  for (int level = TILE_MIN_LEVEL; level <= TILE_MAX_LEVEL; level++) {
+    Level& grid = levels_[level - TILE_MIN_LEVEL];
+    grid.first_column = grid.first_row = 0;
+    grid.columns = grid.rows = 0;
+    if (!box.IsEmpty()) {
+      /* One more pixel around, for outlines rounded outwards */
+      double level_scale = ldexp(1.0, level);
+      grid.first_column = TileOf((int64_t) floor(box.GetXMin() * level_scale) - 1);
+      grid.first_row = TileOf((int64_t) floor(box.GetYMin() * level_scale) - 1);
+      grid.columns = TileOf((int64_t) ceil(box.GetXMax() * level_scale) + 1) - grid.first_column + 1;
+      grid.rows = TileOf((int64_t) ceil(box.GetYMax() * level_scale) + 1) - grid.first_row + 1;
+    }
+    Tile cold = {0, -1, 0, -1, 0, -1};
+    grid.tiles.assign(grid.columns * grid.rows, cold);
+  }
+}
+
+/* Render a cold tile */
+bool TilePyramid::WarmTile(int level, Tile& tile, int column, int row) {
+  Layer *layer = 0;
+  if (tile_count_ < TILE_CACHE_LIMIT) {
+    layer = new Layer(TILE_SIZE, TILE_SIZE);
+    tile_count_++;
+  } else {
+    /* Reuse the least recently used tile that this Draw did not read */
+    Tile *oldest = 0;
+    for (unsigned int i = 0; i < levels_.size(); i++) {
+      for (unsigned int j = 0; j < levels_[i].tiles.size(); j++) {
+        Tile& kept = levels_[i].tiles[j];
+        if (kept.layer && kept.last_used < draw_count_ && (!oldest || kept.last_used < oldest->last_used)) {
+          oldest = &kept;
+        }
+      }
+    }
+    if (!oldest) {
+      return false;
+    }
+    layer = oldest->layer;
+    oldest->layer = 0;
+    oldest->last_used = -1;
+  }
+
+  double level_scale = ldexp(1.0, level);
+  int margin = (int) ceil(1.0 / level_scale) + 1;
+  Point query_top_left((int) floor(column * TILE_SIZE / level_scale) - margin, (int) floor(row * TILE_SIZE / level_scale) - margin);
+  Point query_bottom_right((int) ceil((column + 1) * TILE_SIZE / level_scale) + margin, (int) ceil((row + 1) * TILE_SIZE / level_scale) + margin);
+  Transform2D transform = Transform2D::Scaling(Point(0, 0), level_scale).Then(
+    Transform2D::Translation(Point(-column * TILE_SIZE, -row * TILE_SIZE)));
+  layer->Clear();
+  BoundingBox content;
+  DrawSources(layer->GetFramebuffer(), transform, level_scale, query_top_left, query_bottom_right, Point(0, 0), Point(TILE_SIZE - 1, TILE_SIZE - 1), &content);
+  tile.layer = layer;
+  tile.x_min = tile.y_min = 0;
+  tile.x_max = tile.y_max = -1;
+  if (!content.IsOutside(Point(0, 0), Point(TILE_SIZE - 1, TILE_SIZE - 1))) {
+    tile.x_min = std::max(content.GetXMin(), 0);
+    tile.x_max = std::min(content.GetXMax(), TILE_SIZE - 1);
+    tile.y_min = std::max(content.GetYMin(), 0);
+    tile.y_max = std::min(content.GetYMax(), TILE_SIZE - 1);
+  }
+  return true;
+}
+
+/* Draw the part of the sources inside a source rectangle */
+void TilePyramid::DrawSources(Framebuffer& fb, const Transform2D& transform, double scale, const Point& source_top_left, const Point& source_bottom_right, const Point& top_left, const Point& bottom_right, BoundingBox *content) {
+  int level = Sprite::GetLevelOfDetailFor(scale);
+  for (unsigned int i = 0; i < sources_.size(); i++) {
+    Sprite source = sources_[i]->GetLevelOfDetail(level);
+    source.FindPolygons(source_top_left, source_bottom_right, candidates_);
+    fb.DrawClippedSprite(source, candidates_.data(), candidates_.size(), transform, top_left, bottom_right);
+    for (unsigned int j = 0; content && j < candidates_.size(); j++) {
+      content->Add(source.GetBoundingBox(candidates_[j]).Transform(transform));
+    }
+  }
+}
@@ -0,0 +1,123 @@
+#ifndef TILE_PYRAMID_H
+#define TILE_PYRAMID_H
+
+#include "framebuffer.h"
+#include "layer.h"
+#include "sprite.h"
+#include "point.h"
+#include "transform.h"
+#include <vector>
+
+/* Tiles are square, TILE_SIZE pixels wide */
+#define TILE_SIZE 128
+
+/* Level k of the pyramid draws the sources scaled by 2^k. Enlarged views fill
+big spans straight from the polygons faster than they blend tiles, so the
+pyramid stops at full size */
+#define TILE_MIN_LEVEL -3
+#define TILE_MAX_LEVEL 0
+
+/* Tiles kept at most, the least recently used one is reused first */
+#define TILE_CACHE_LIMIT 256
+
+/* Cold tiles rendered per Draw, the others are drawn from the sources */
+#define TILE_WARM_LIMIT 8
+
+/* Raster cache of static sprites: a mip style pyramid of levels, each the
+sources rendered at a power of two scale and cut into tiles that are
+rendered on first use. Drawing a shrunk view of the sources then blends and
+scales the tiles covering it instead of rasterizing polygons */
+class TilePyramid {
+public:
+  /* Constructor (no sources) */
+  TilePyramid();
+
+  /* Destructor */
+  ~TilePyramid();
+
+  /* Add a sprite drawn into the tiles, after the sprites added before it */
+  void AddSource(const Sprite *sprite);
+
+  /* Drop every source and tile */
+  void Reset();
+
+  /* Drop every tile, to be called after a source changed */
+  void Invalidate();
+
+  /* Draw the sources scaled by (x_scale, y_scale), with source point
+  source_top_left at top_left, clipped to the rectangle from top_left to
+  bottom_right. Returns false, drawing nothing, if no level fits the scale */
+  bool Draw(Framebuffer& fb, const Point& source_top_left, double x_scale, double y_scale, const Point& top_left, const Point& bottom_right);
+
+  /* Getter */
+  int GetTileCount() const; /* tiles rendered and kept */
+
+private:
+  /* No copies, tiles are owned */
+  TilePyramid(const TilePyramid&);
+  TilePyramid& operator=(const TilePyramid&);
+
+  struct Tile {
+    Layer *layer; /* 0 while cold */
+    long last_used; /* Draw call that last read it */
+    int x_min; /* pixels of the layer that may not be transparent, */
+    int x_max; /* empty if x_min > x_max */
+    int y_min;
+    int y_max;
+  };
+
+  /* Tiles of one level, covering the sources */
+  struct Level {
+    int first_column;
+    int first_row;
+    int columns;
+    int rows;
+    std::vector<Tile> tiles;
+  };
+
+  /* Columns of a view sharing a tile column: first to last draw tile column
+  tile, sampled from u (16.16 fixed point, in level pixels) */
+  struct TileRun {
+    int first;
+    int last;
+    int tile;
+    int64_t u;
+  };
+
+  /* Cut the pixels from first to last, sampling u_first + (x - first) * step,
+  into runs of the same tile */
+  static void SplitRuns(int first, int last, int64_t u_first, int64_t step, std::vector<TileRun>& runs);
+
+  /* Shrink the pixels from first to last, sampling u (moved along) as above,
+  to the ones sampling tile pixels from low to high. Returns false if none do */
+  static bool ClipRun(int& first, int& last, int64_t& u, int64_t step, int low, int high);
+
+  /* Lay out the tile grids of every level over the sources */
+  void BuildLevels();
+
+  /* Render a cold tile, reusing the least recently used one if the cache is
+  full. Returns false if every kept tile is in use */
+  bool WarmTile(int level, Tile& tile, int column, int row);
+
+  /* Draw the part of a view (see Draw) from run_top_left to run_bottom_right
+  from the sources, as View::Render would */
+  void DrawRun(Framebuffer& fb, const Point& source_top_left, double x_scale, double y_scale, const Point& top_left, const Point& run_top_left, const Point& run_bottom_right);
+
+  /* Draw the part of the sources inside the source rectangle from
+  source_top_left to source_bottom_right, moved by transform and clipped to
+  the rectangle from top_left to bottom_right. The moved boxes of the drawn
+  polygons are added to content, if it is not 0 */
+  void DrawSources(Framebuffer& fb, const Transform2D& transform, double scale, const Point& source_top_left, const Point& source_bottom_right, const Point& top_left, const Point& bottom_right, BoundingBox *content = 0);
+
+  std::vector<const Sprite*> sources_;
+  std::vector<Level> levels_; /* from TILE_MIN_LEVEL up, empty until first drawn */
+  int tile_count_;
+  long draw_count_;
+
+  /* Scratch space */
+  std::vector<TileRun> column_runs_;
+  std::vector<TileRun> row_runs_;
+  std::vector<int> candidates_;
+};
+
+#endif
@@ -0,0 +1,181 @@
+#include "transform.h"
+#include "pixel_kernels.h"
+#include <cmath>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define TRANSFORM_X86
+#include <immintrin.h>
+#endif
+
+/* Sines and cosines of every angle step, built on first use */
+struct TrigTable {
+  Factor sines[ANGLE_STEPS];
+  Factor cosines[ANGLE_STEPS];
+
+  TrigTable() {
+    for (int i = 0; i < ANGLE_STEPS; i++) {
+      double theta = i / (double) ANGLE_STEPS_PER_DEGREE;
+      sines[i] = FactorFromDouble(std::sin(theta * PI / 180));
+      cosines[i] = FactorFromDouble(std::cos(theta * PI / 180));
+    }
+  }
+};
+
+static const TrigTable& GetTrigTable() {
+  static const TrigTable table;
+  return table;
+}
+
+/* factor * value with value in FACTOR_ONE units, rounded. The value is split
+so that the product never overflows 64 bits */
+static int64_t MultiplyWide(Factor factor, int64_t value) {
+  int64_t high = value >> FACTOR_SHIFT;
+  int64_t low = value & (FACTOR_ONE - 1);
+  return factor * high + ((factor * low + FACTOR_ONE / 2) >> FACTOR_SHIFT);
+}
+
+/* Constructor (identity) */
+Transform2D::Transform2D() : a_(FACTOR_ONE), b_(0), c_(0), d_(FACTOR_ONE), tx_(0), ty_(0) {}
+
+/* Returns the translation by offset */
+Transform2D Transform2D::Translation(const Point& offset) {
+  Transform2D result;
+  result.tx_ = (int64_t) offset.GetCoordX() * FACTOR_ONE;
+  result.ty_ = (int64_t) offset.GetCoordY() * FACTOR_ONE;
+  return result;
+}
+
+/* Returns the scaling by scale factor with the specified pivot */
+Transform2D Transform2D::Scaling(const Point& pivot, double scale_factor) {
+  return Scaling(pivot, scale_factor, scale_factor);
+}
+
+Transform2D Transform2D::Scaling(const Point& pivot, double x_scale_factor, double y_scale_factor) {
+  Transform2D result;
+  result.a_ = FactorFromDouble(x_scale_factor);
+  result.d_ = FactorFromDouble(y_scale_factor);
+  result.tx_ = (int64_t) pivot.GetCoordX() * (FACTOR_ONE - result.a_);
+  result.ty_ = (int64_t) pivot.GetCoordY() * (FACTOR_ONE - result.d_);
+  return result;
+}
+
+/* Returns the rotation by theta degree with the specified pivot */
+Transform2D Transform2D::Rotation(const Point& pivot, double theta) {
+  Transform2D result;
+  Factor sin_theta;
+  Factor cos_theta;
+  SinCos(theta, &sin_theta, &cos_theta);
+  int64_t x = pivot.GetCoordX();
+  int64_t y = pivot.GetCoordY();
+  result.a_ = cos_theta;
+  result.b_ = -sin_theta;
+  result.c_ = sin_theta;
+  result.d_ = cos_theta;
+  result.tx_ = x * (FACTOR_ONE - cos_theta) + y * sin_theta;
+  result.ty_ = y * (FACTOR_ONE - cos_theta) - x * sin_theta;
+  return result;
+}
+
+/* Returns this transform followed by next */
+Transform2D Transform2D::Then(const Transform2D& next) const {
+  Transform2D result;
+  result.a_ = MultiplyFactor(next.a_, a_) + MultiplyFactor(next.b_, c_);
+  result.b_ = MultiplyFactor(next.a_, b_) + MultiplyFactor(next.b_, d_);
+  result.c_ = MultiplyFactor(next.c_, a_) + MultiplyFactor(next.d_, c_);
+  result.d_ = MultiplyFactor(next.c_, b_) + MultiplyFactor(next.d_, d_);
+  result.tx_ = MultiplyWide(next.a_, tx_) + MultiplyWide(next.b_, ty_) + next.tx_;
+  result.ty_ = MultiplyWide(next.c_, tx_) + MultiplyWide(next.d_, ty_) + next.ty_;
+  return result;
+}
+
+/* Returns p transformed */
+Point Transform2D::Apply(const Point& p) const {
+  int64_t x = p.GetCoordX();
+  int64_t y = p.GetCoordY();
+  return Point::FromCoord((Coord) ((a_ * x + b_ * y + tx_ + FACTOR_ONE / 2) >> FACTOR_SHIFT),
+                          (Coord) ((c_ * x + d_ * y + ty_ + FACTOR_ONE / 2) >> FACTOR_SHIFT));
+}
+
+#ifdef TRANSFORM_X86
+/* a x + b y + t for the points in the even 32 bit lanes of x and y */
+__attribute__((target("avx2")))
+static inline __m256i SumAVX2(__m256i x, __m256i y, __m256i a, __m256i b, __m256i t) {
+  return _mm256_add_epi64(_mm256_add_epi64(_mm256_mul_epi32(x, a), _mm256_mul_epi32(y, b)), t);
+}
+
+/* Transform eight points per iteration, returns how many were done */
+__attribute__((target("avx2")))
+static int ApplyAVX2(const Coord *xs, const Coord *ys, int count, Coord *result_xs, Coord *result_ys, Factor a, Factor b, Factor c, Factor d, int64_t tx, int64_t ty) {
+  const __m256i a4 = _mm256_set1_epi64x(a);
+  const __m256i b4 = _mm256_set1_epi64x(b);
+  const __m256i c4 = _mm256_set1_epi64x(c);
+  const __m256i d4 = _mm256_set1_epi64x(d);
+  const __m256i tx4 = _mm256_set1_epi64x(tx + FACTOR_ONE / 2);
+  const __m256i ty4 = _mm256_set1_epi64x(ty + FACTOR_ONE / 2);
+  int i = 0;
+  for (; i + 8 <= count; i += 8) {
+    __m256i x_even = _mm256_loadu_si256((const __m256i*) (xs + i));
+    __m256i y_even = _mm256_loadu_si256((const __m256i*) (ys + i));
+    __m256i x_odd = _mm256_srli_epi64(x_even, 32);
+    __m256i y_odd = _mm256_srli_epi64(y_even, 32);
+    __m256i x0 = SumAVX2(x_even, y_even, a4, b4, tx4);
+    __m256i x1 = SumAVX2(x_odd, y_odd, a4, b4, tx4);
+    __m256i y0 = SumAVX2(x_even, y_even, c4, d4, ty4);
+    __m256i y1 = SumAVX2(x_odd, y_odd, c4, d4, ty4);
+    __m256i x = _mm256_blend_epi32(_mm256_srli_epi64(x0, FACTOR_SHIFT), _mm256_slli_epi64(x1, 32 - FACTOR_SHIFT), 0xaa);
+    __m256i y = _mm256_blend_epi32(_mm256_srli_epi64(y0, FACTOR_SHIFT), _mm256_slli_epi64(y1, 32 - FACTOR_SHIFT), 0xaa);
+    _mm256_storeu_si256((__m256i*) (result_xs + i), x);
+    _mm256_storeu_si256((__m256i*) (result_ys + i), y);
+  }
+  _mm256_zeroupper();
+  return i;
+}
+#endif
+
+/* Transform count points (xs[i], ys[i]) into result_xs and result_ys */
+void Transform2D::Apply(const Coord *xs, const Coord *ys, int count, Coord *result_xs, Coord *result_ys) const {
+  int i = 0;
+#ifdef TRANSFORM_X86
+  /* SSE2 has no signed 32 bit multiply, the scalar loop is as fast there */
+  if (PixelKernels::GetLevel() >= KERNEL_AVX2) {
+    i = ApplyAVX2(xs, ys, count, result_xs, result_ys, a_, b_, c_, d_, tx_, ty_);
+  }
+#endif
+  for (; i < count; i++) {
+    int64_t x = xs[i];
+    int64_t y = ys[i];
+    result_xs[i] = (Coord) ((a_ * x + b_ * y + tx_ + FACTOR_ONE / 2) >> FACTOR_SHIFT);
+    result_ys[i] = (Coord) ((c_ * x + d_ * y + ty_ + FACTOR_ONE / 2) >> FACTOR_SHIFT);
+  }
+}
+
+/* 16.16 fixed point sine and cosine of theta degree */
+void Transform2D::SinCos(double theta, Factor *sin_theta, Factor *cos_theta) {
+  double steps = theta * ANGLE_STEPS_PER_DEGREE;
+  if (steps == std::floor(steps) && std::fabs(steps) < (1 << 30)) {
+    int step = ((int) steps) % ANGLE_STEPS;
+    if (step < 0) {
+      step += ANGLE_STEPS;
+    }
+    *sin_theta = GetTrigTable().sines[step];
+    *cos_theta = GetTrigTable().cosines[step];
+  } else {
+    *sin_theta = FactorFromDouble(std::sin(theta * PI / 180));
+    *cos_theta = FactorFromDouble(std::cos(theta * PI / 180));
+  }
+}
+
+/* Checks whether this transform only moves points by whole pixels */
+bool Transform2D::IsPixelTranslation() const {
+  const int64_t pixel = (int64_t) COORD_ONE * FACTOR_ONE;
+  return a_ == FACTOR_ONE && b_ == 0 && c_ == 0 && d_ == FACTOR_ONE && tx_ % pixel == 0 && ty_ % pixel == 0;
+}
+
+/* Getter */
+int Transform2D::GetXOffset() const {
+  return (int) (tx_ / ((int64_t) COORD_ONE * FACTOR_ONE));
+}
+
+int Transform2D::GetYOffset() const {
+  return (int) (ty_ / ((int64_t) COORD_ONE * FACTOR_ONE));
+}
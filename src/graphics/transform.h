@@ -0,0 +1,62 @@
+#ifndef TRANSFORM_H
+#define TRANSFORM_H
+
+#include <stdint.h>
+#include "fixed.h"
+#include "point.h"
+
+/* Rotations by a multiple of 1 / ANGLE_STEPS_PER_DEGREE degree read their sine
+and cosine from a table */
+#define ANGLE_STEPS_PER_DEGREE 4
+#define ANGLE_STEPS (360 * ANGLE_STEPS_PER_DEGREE)
+
+/* Affine map of the plane, x' = a x + b y + tx and y' = c x + d y + ty.
+The matrix is kept in 16.16 fixed point and the translation with 16 more
+fractional bits than a Coord, so that applying a composed transform rounds
+once, exactly like Point::ScaleFixed and Point::RotateFixed do */
+class Transform2D {
+public:
+  /* Constructor (identity) */
+  Transform2D();
+
+  /* Returns the translation by offset */
+  static Transform2D Translation(const Point& offset);
+
+  /* Returns the scaling by scale factor with the specified pivot */
+  static Transform2D Scaling(const Point& pivot, double scale_factor);
+  static Transform2D Scaling(const Point& pivot, double x_scale_factor, double y_scale_factor);
+
+  /* Returns the rotation by theta degree with the specified pivot */
+  static Transform2D Rotation(const Point& pivot, double theta);
+
+  /* Returns this transform followed by next */
+  Transform2D Then(const Transform2D& next) const;
+
+  /* Returns p transformed */
+  Point Apply(const Point& p) const;
+
+  /* Transform count points (xs[i], ys[i]) into result_xs and result_ys (which
+  may be xs and ys), several per SIMD instruction */
+  void Apply(const Coord *xs, const Coord *ys, int count, Coord *result_xs, Coord *result_ys) const;
+
+  /* 16.16 fixed point sine and cosine of theta degree */
+  static void SinCos(double theta, Factor *sin_theta, Factor *cos_theta);
+
+  /* Checks whether this transform only moves points by whole pixels, so that
+  cached edge tables can be drawn with an offset instead */
+  bool IsPixelTranslation() const;
+
+  /* Getter (translation in whole pixels, see IsPixelTranslation) */
+  int GetXOffset() const;
+  int GetYOffset() const;
+
+private:
+  Factor a_;
+  Factor b_;
+  Factor c_;
+  Factor d_;
+  int64_t tx_; /* Coord * FACTOR_ONE */
+  int64_t ty_;
+};
+
+#endif
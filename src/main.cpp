@@ -1,4 +1,5 @@
 #include "graphics/framebuffer.h"
+#include "graphics/command_buffer.h"
 #include "graphics/sprite.h"
 #include "objects/font.h"
 #include "objects/view.h"
@@ -6,10 +7,16 @@
 #include "objects/gun_fire.h"
 #include "utils/input.h"
 #include "utils/mouse_listener.h"
+#include "utils/frame_pacer.h"
+#include "utils/profiler.h"
+#include "utils/input_log.h"
 #include <vector>
 #include <unistd.h>
 #include <stdlib.h>
+#include <string.h>
+#include <signal.h>
 #include <time.h>
+#include <thread>
 #include <iostream>
 using namespace std;
 
@@ -30,8 +37,24 @@ using namespace std;
 #define EXIT 3
 
 /* Global variables */
+int frames_per_second = FPS;
+bool profiled = false; /* whether the profiler was turned on at some point */
+const char *record_path = 0; /* input log of the last game played */
+const char *replay_path = 0; /* input log the game reads instead of the devices */
+
+/* Profiled stages of the game loop */
+int stage_frame = Profiler::RegisterStage("frame");
+int stage_clear = Profiler::RegisterStage("clear");
+int stage_main_screen = Profiler::RegisterStage("main_screen");
+int stage_mini_map = Profiler::RegisterStage("mini_map");
+int stage_game_screen = Profiler::RegisterStage("game_screen");
+int stage_gun_fires = Profiler::RegisterStage("gun_fires");
+int stage_enemies = Profiler::RegisterStage("enemies");
+int stage_collide = Profiler::RegisterStage("is_collide");
+int stage_player = Profiler::RegisterStage("player");
+int stage_display = Profiler::RegisterStage("display");
 Font font("../data/font.txt");
-Framebuffer fb("/dev/fb0");
+Framebuffer fb("/dev/fb0", 32, true);
 Sprite facilities("../data/facilities.txt");
 Sprite buildings("../data/buildings.txt");
 Sprite poles("../data/poles.txt");
@@ -52,11 +75,45 @@ void PlayGame();
 /* Play the credits scene */
 void PlayCredits();
 
-int main() {
+int main(int argc, char *argv[]) {
+  /* --fps N sets the target frame rate, 0 runs uncapped. --profile turns the
+  profiler on from the start (p toggles it in game, SIGUSR1 prints it).
+  --record FILE logs the input of the game, --replay FILE plays a logged game
+  again, frame for frame, and exits */
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--fps") == 0 && i + 1 < argc) {
+      frames_per_second = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--profile") == 0) {
+      profiled = true;
+      Profiler::SetEnabled(true);
+    } else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+      record_path = argv[++i];
+    } else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+      replay_path = argv[++i];
+    } else {
+      cerr << "Usage: " << argv[0] << " [--fps N] [--profile] [--record FILE | --replay FILE]" << endl;
+      return 1;
+    }
+  }
+  Profiler::DumpOnSignal(SIGUSR1);
+
   /* initialize random seed */
   srand (time(NULL));
 
-  int code = MainMenu();
+  /* flip pages when the driver can pan, otherwise every loop redraws the whole
+  screen, so only present tiles whose content changed */
+  if (!fb.SetPageFlipping(true)) {
+    fb.SetDamageMode(DAMAGE_TILES_HASHED);
+  }
+
+  /* rasterize the map in bands on every core */
+  fb.SetRasterThreads(std::thread::hardware_concurrency());
+
+  /* a replay plays the logged game and quits */
+  if (replay_path) {
+    PlayGame();
+  }
+  int code = replay_path ? EXIT : MainMenu();
   while(code != EXIT) {
     switch(code) {
       case PLAY:
@@ -70,6 +127,9 @@ int main() {
   }
   fb.Clear();
   fb.Display();
+  if (profiled) {
+    Profiler::Dump(stderr);
+  }
   return 0;
 }
 
@@ -110,6 +170,7 @@ int MainMenu() {
   preview_screen.AddSource(&buildings);
   preview_screen.AddSource(&facilities);
   preview_screen.AddSource(&poles);
+  preview_screen.SetTileCaching(true);
 
   Point preview_source_top_left = Point(250, 500);
   Point preview_source_bottom_right = Point(350, 600);
@@ -123,6 +184,13 @@ int MainMenu() {
   Point cursor_position;
   int chosen = 0;
 
+  /* The buttons never change, record them once and replay them every frame */
+  CommandBuffer menu_text;
+  for (int i = 0; i < 4; i++) {
+    Font::RenderText(text[i], font, menu_text, text_top_left[i], COLOR_WHITE, COLOR_RED, COLOR_BLACK, text_scale[i], main_screen_top_left, main_screen_bottom_right);
+  }
+
+  FramePacer pacer(frames_per_second);
   while(!chosen) {
     preview_screen.SetSourcePosition(preview_source_top_left, preview_source_bottom_right);
 
@@ -144,9 +212,7 @@ int MainMenu() {
     preview_screen.Render(fb);
 
     /* Display buttons and text */
-    for (int i = 0; i < 4; i++) {
-      Font::RenderText(text[i], font, fb, text_top_left[i], COLOR_WHITE, COLOR_RED, COLOR_BLACK, text_scale[i], main_screen_top_left, main_screen_bottom_right);
-    }
+    fb.Execute(menu_text);
 
     player.Render(fb, preview_screen_top_left, preview_screen_bottom_right);
     cursor_position = mouse_listener.GetPosition();
@@ -161,7 +227,7 @@ int MainMenu() {
       preview_source_bottom_right.SetY(MAP_HEIGHT + preview_source_bottom_right.GetX() - preview_source_top_left.GetX());
     }
 
-    usleep(1000 / FPS * 1000);
+    pacer.Wait();
   }
 
   return chosen;
@@ -183,6 +249,7 @@ void PlayGame() {
   mini_map.AddSource(&buildings);
   mini_map.AddSource(&facilities);
   mini_map.AddSource(&poles);
+  mini_map.SetTileCaching(true);
   mini_map.SetSourcePosition(Point(0, 0), Point(MAP_WIDTH, MAP_HEIGHT));
 
   Point game_screen_top_left = main_screen_top_left;
@@ -191,6 +258,7 @@ void PlayGame() {
   game_screen.AddSource(&buildings);
   game_screen.AddSource(&facilities);
   game_screen.AddSource(&poles);
+  game_screen.SetTileCaching(true);
 
   Point game_source_top_left = Point(250, 500);
   Point game_source_bottom_right = Point(350, 600);
@@ -201,23 +269,51 @@ void PlayGame() {
   Point start = Point(game_screen_bottom_right.GetX() - GAME_SCREEN_WIDTH / 2, game_screen_bottom_right.GetY() - 75);
   player.SetCenter(start);
   player.Scale(4);
-  MouseListener mouse_listener(Point::Translate(game_screen_top_left, Point(50, GAME_SCREEN_HEIGHT / 2 + 50)),
-                               Point::Translate(game_screen_bottom_right, Point(-50, -54)), start);
 
-  char key;
-  Input input;
-  input.Flush();
+  /* Input comes from the devices, or from the log when replaying. The waves
+  are seeded so that a replay spawns the same enemies */
+  InputReplayer *replayer = replay_path ? new InputReplayer(replay_path) : 0;
+  unsigned seed = replayer ? replayer->GetSeed() : time(NULL);
+  srand(seed);
+  InputRecorder *recorder = record_path ? new InputRecorder(record_path, seed) : 0;
+
+  MouseListener *mouse_listener = 0;
+  Input *input = 0;
+  if (!replayer) {
+    mouse_listener = new MouseListener(Point::Translate(game_screen_top_left, Point(50, GAME_SCREEN_HEIGHT / 2 + 50)),
+                                       Point::Translate(game_screen_bottom_right, Point(-50, -54)), start);
+    input = new Input();
+    input->Flush();
+  }
+  FrameInput frame_input;
 
   vector<Plane> enemies;
   vector<GunFire> gun_fires;
+  GunFireScratch gun_fire_scratch;
   int counter = 1;
   int wave_time = rand() % 10 + 5;
 
   /* Game loop */
+  FramePacer pacer(frames_per_second);
   while(!died && !end) {
     game_screen.SetSourcePosition(game_source_top_left, game_source_bottom_right);
 
-    key = input.GetKeyPressed();
+    /* Read the input of this frame once */
+    if (replayer) {
+      if (!replayer->Next(frame_input)) {
+        break;
+      }
+    } else {
+      frame_input.key = input->GetKeyPressed();
+      frame_input.left_click = mouse_listener->IsLeftClicked();
+      frame_input.mouse_position = mouse_listener->GetPosition();
+      input->Flush();
+    }
+    if (recorder) {
+      recorder->Record(frame_input);
+    }
+
+    char key = frame_input.key;
     if (key == 'q') {
       end = true;
     } else if (key == 'a') { /* Move map left */
@@ -250,20 +346,34 @@ void PlayGame() {
         game_source_top_left.Translate(Point(5, 5));
         game_source_bottom_right.Translate(Point(-5, -5));
       }
+    } else if (key == 'p') { /* Toggle the profiler */
+      profiled = true;
+      Profiler::SetEnabled(!Profiler::IsEnabled());
     }
-    input.Flush();
 
-    fb.Clear();
+    {
+      ScopedTimer timer(stage_clear);
+      fb.Clear();
+    }
 
     /* Display game screen */
-    main_screen.Render(fb);
-    mini_map.Render(fb);
-    game_screen.Render(fb);
+    {
+      ScopedTimer timer(stage_main_screen);
+      main_screen.Render(fb);
+    }
+    {
+      ScopedTimer timer(stage_mini_map);
+      mini_map.Render(fb);
+    }
+    {
+      ScopedTimer timer(stage_game_screen);
+      game_screen.Render(fb);
+    }
 
     /* Read mouse input */
-    if (mouse_listener.IsLeftClicked()) {
-      Point start = Point::Translate(mouse_listener.GetPosition(), Point(0, -60));
-      Point end = Point::Translate(mouse_listener.GetPosition(), Point(0, -60 - GUN_FIRE_LENGTH));
+    if (frame_input.left_click) {
+      Point start = Point::Translate(frame_input.mouse_position, Point(0, -60));
+      Point end = Point::Translate(frame_input.mouse_position, Point(0, -60 - GUN_FIRE_LENGTH));
       gun_fires.push_back(GunFire(start, end, GUN_FIRE_COLOR, GUN_FIRE_SPEED));
     }
 
@@ -283,57 +393,71 @@ void PlayGame() {
       enemies.push_back(enemy);
     }
 
-    /* Display gun fires */
-    for (unsigned i = 0; i < gun_fires.size(); i++) {
-      gun_fires[i].Render(fb, game_screen_top_left, game_screen_bottom_right);
-    }
-
-    /* Remove hit gun fires */
-    for (vector<GunFire>::iterator it = gun_fires.begin(); it != gun_fires.end(); ) {
-      bool hit = false;
-      unsigned i = 0;
-      while (!hit && i < enemies.size()) {
-        Point top_left = enemies[i].GetTopLeft();
-        Point bottom_right = enemies[i].GetBottomRight();
-        if ((top_left.GetX() <= it->GetStart().GetX() && it->GetStart().GetX() <= bottom_right.GetX() &&
-             top_left.GetY() <= it->GetStart().GetY() && it->GetStart().GetY() <= bottom_right.GetY()) ||
-            (top_left.GetX() <= it->GetEnd().GetX() && it->GetEnd().GetX() <= bottom_right.GetX() &&
-             top_left.GetY() <= it->GetEnd().GetY() && it->GetEnd().GetY() <= bottom_right.GetY())) {
-          hit = true;
+    {
+      ScopedTimer timer(stage_gun_fires);
+
+      /* Display gun fires */
+      GunFire::RenderAll(gun_fires, fb, game_screen_top_left, game_screen_bottom_right, gun_fire_scratch);
+
+      /* Remove hit gun fires */
+      for (vector<GunFire>::iterator it = gun_fires.begin(); it != gun_fires.end(); ) {
+        bool hit = false;
+        unsigned i = 0;
+        while (!hit && i < enemies.size()) {
+          Point top_left = enemies[i].GetTopLeft();
+          Point bottom_right = enemies[i].GetBottomRight();
+          if ((top_left.GetX() <= it->GetStart().GetX() && it->GetStart().GetX() <= bottom_right.GetX() &&
+               top_left.GetY() <= it->GetStart().GetY() && it->GetStart().GetY() <= bottom_right.GetY()) ||
+              (top_left.GetX() <= it->GetEnd().GetX() && it->GetEnd().GetX() <= bottom_right.GetX() &&
+               top_left.GetY() <= it->GetEnd().GetY() && it->GetEnd().GetY() <= bottom_right.GetY())) {
+            hit = true;
+          } else {
+            i++;
+          }
+        }
+        if (hit) {
+          it = gun_fires.erase(it);
         } else {
-          i++;
+          ++it;
         }
       }
-      if (hit) {
-        it = gun_fires.erase(it);
-      } else {
-        ++it;
-      }
     }
 
     /* Display enemies (destroy enemy if hit with gun fire) */
-    for (vector<Plane>::iterator it = enemies.begin(); it != enemies.end(); ) {
-      if (it->IsCollide(fb, GUN_FIRE_COLOR)) {
-        it->Render(fb, game_screen_top_left, game_screen_bottom_right);
-        it = enemies.erase(it);
-      } else {
-        it->Render(fb, game_screen_top_left, game_screen_bottom_right);
-        ++it;
+    {
+      ScopedTimer timer(stage_enemies);
+      for (vector<Plane>::iterator it = enemies.begin(); it != enemies.end(); ) {
+        bool hit;
+        {
+          ScopedTimer collide_timer(stage_collide);
+          hit = it->IsCollide(fb, GUN_FIRE_COLOR);
+        }
+        if (hit) {
+          it->Render(fb, game_screen_top_left, game_screen_bottom_right);
+          it = enemies.erase(it);
+        } else {
+          it->Render(fb, game_screen_top_left, game_screen_bottom_right);
+          ++it;
+        }
       }
     }
 
-    /* Game over if collided with enemy */
-    if (player.IsCollide(fb, COLOR_RED)) {
-      player.SetCenter(mouse_listener.GetPosition());
+    /* Game over if collided with enemy, after showing this frame */
+    {
+      ScopedTimer timer(stage_collide);
+      died = player.IsCollide(fb, COLOR_RED);
+    }
+
+    {
+      ScopedTimer timer(stage_player);
+      player.SetCenter(frame_input.mouse_position);
       player.Render(fb, game_screen_top_left, game_screen_bottom_right);
+    }
+    {
+      ScopedTimer timer(stage_display);
       fb.Display();
-      died = true;
     }
 
-    player.SetCenter(mouse_listener.GetPosition());
-    player.Render(fb, game_screen_top_left, game_screen_bottom_right);
-    fb.Display();
-
     /* Move gun fires and remove out of frame gun fires */
     for (vector<GunFire>::iterator it = gun_fires.begin(); it != gun_fires.end(); ) {
       it->Move();
@@ -362,8 +486,14 @@ void PlayGame() {
       game_source_bottom_right.SetY(MAP_HEIGHT + game_source_bottom_right.GetX() - game_source_top_left.GetX());
     }
 
-    usleep(1000 / FPS * 1000);
+    pacer.Wait();
+    Profiler::Record(stage_frame, pacer.GetLastWorkTime());
+    Profiler::DumpIfRequested(stderr);
   }
+  delete input;
+  delete mouse_listener;
+  delete recorder;
+  delete replayer;
 
   if(died) {
     fb.Clear();
@@ -409,6 +539,7 @@ void PlayCredits() {
  int scale = 3;
 
  /* Main loop */
+ FramePacer pacer(frames_per_second);
  while (start >= -650) {
    fb.Clear();
 
@@ -423,6 +554,6 @@ void PlayCredits() {
    start -= 5;
    main_screen.Render(fb);
    fb.Display();
-   usleep(1000 / FPS * 1000);
+   pacer.Wait();
  }
 }
@@ -36,15 +36,27 @@ Font::Font(const char *file_path) {
 
 /* Render text */
 void Font::RenderText(std::string text, const Font& font, Framebuffer& fb, const Point& start_position, const Color& border_color, const Color& fill_color, const Color& background_color, int scale, const Point& top_left, const Point& bottom_right) {
+  RenderGlyphs(text, font, fb, start_position, border_color, fill_color, background_color, scale, top_left, bottom_right);
+}
+
+/* Record text into a command buffer */
+void Font::RenderText(std::string text, const Font& font, CommandBuffer& commands, const Point& start_position, const Color& border_color, const Color& fill_color, const Color& background_color, int scale, const Point& top_left, const Point& bottom_right) {
+  RenderGlyphs(text, font, commands, start_position, border_color, fill_color, background_color, scale, top_left, bottom_right);
+}
+
+/* Draw the glyphs of text to anything with a DrawRasteredPolygon */
+template <class Target>
+void Font::RenderGlyphs(const std::string& text, const Font& font, Target& target, const Point& start_position, const Color& border_color, const Color& fill_color, const Color& background_color, int scale, const Point& top_left, const Point& bottom_right) {
   for (unsigned int i = 0; i < text.length(); i++) {
     int xoffset = start_position.GetX() + i * (font.width_ * scale + font.horizontal_space_);
     if (text[i] != ' ') {
       int idx = text[i] - 'A';
+      Transform2D transform = Transform2D::Scaling(Point(0, 0), scale).Then(Transform2D::Translation(Point(xoffset, start_position.GetY())));
       for (unsigned int j = 0; j < font.alphabets_[idx].size(); j++) {
         if (j == 0) {
-          fb.DrawRasteredPolygon(Polygon::Scale(font.alphabets_[idx][j], Point(0, 0), scale), border_color, fill_color, top_left, bottom_right, xoffset, start_position.GetY());
+          target.DrawRasteredPolygon(font.alphabets_[idx][j], transform, border_color, fill_color, top_left, bottom_right);
         } else {
-          fb.DrawRasteredPolygon(Polygon::Scale(font.alphabets_[idx][j], Point(0, 0), scale), border_color, background_color, top_left, bottom_right, xoffset, start_position.GetY());
+          target.DrawRasteredPolygon(font.alphabets_[idx][j], transform, border_color, background_color, top_left, bottom_right);
         }
       }
     }
@@ -2,7 +2,9 @@
 #define FONT_H
 
 #include "../graphics/polygon.h"
+#include "../graphics/transform.h"
 #include "../graphics/framebuffer.h"
+#include "../graphics/command_buffer.h"
 #include "../graphics/color.h"
 #include <string>
 #include <vector>
@@ -15,6 +17,9 @@ public:
 	/* Render text */
 	static void RenderText(std::string text, const Font& font, Framebuffer& fb, const Point& start_position, const Color& border_color, const Color& fill_color, const Color& background_color, int scale, const Point& top_left, const Point& bottom_right);
 
+	/* Record text into a command buffer */
+	static void RenderText(std::string text, const Font& font, CommandBuffer& commands, const Point& start_position, const Color& border_color, const Color& fill_color, const Color& background_color, int scale, const Point& top_left, const Point& bottom_right);
+
 	/* Getter */
 	int GetWidth() const;
 	int GetHeight() const;
@@ -22,6 +27,10 @@ public:
 	int GetVerticalSpace() const;
 
 private:
+	/* Draw the glyphs of text to anything with a DrawRasteredPolygon */
+	template <class Target>
+	static void RenderGlyphs(const std::string& text, const Font& font, Target& target, const Point& start_position, const Color& border_color, const Color& fill_color, const Color& background_color, int scale, const Point& top_left, const Point& bottom_right);
+
 	int height_;
 	int width_;
 	int horizontal_space_;
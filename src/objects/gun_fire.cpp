@@ -13,6 +13,26 @@ void GunFire::Render(Framebuffer& fb, const Point& top_left, const Point& bottom
   fb.ClipLine(start_, end_, top_left, bottom_right, color_);
 }
 
+/* Render many gun fires, clipping those of the same color together */
+void GunFire::RenderAll(const std::vector<GunFire>& gun_fires, Framebuffer& fb, const Point& top_left, const Point& bottom_right, GunFireScratch& scratch) {
+  std::vector<Point>& starts = scratch.starts;
+  std::vector<Point>& ends = scratch.ends;
+  unsigned first = 0;
+  while (first < gun_fires.size()) {
+    const Color& color = gun_fires[first].color_;
+    starts.clear();
+    ends.clear();
+    unsigned last = first;
+    while (last < gun_fires.size() && Color::IsColorSame(gun_fires[last].color_, color)) {
+      starts.push_back(gun_fires[last].start_);
+      ends.push_back(gun_fires[last].end_);
+      last++;
+    }
+    fb.ClipLines(starts.data(), ends.data(), starts.size(), top_left, bottom_right, color);
+    first = last;
+  }
+}
+
 /* Move gun fire */
 void GunFire::Move() {
   start_.Translate(Point(0, y_speed_));
@@ -4,6 +4,14 @@
 #include "../graphics/point.h"
 #include "../graphics/framebuffer.h"
 #include "../graphics/color.h"
+#include <vector>
+
+/* Point arrays RenderAll gathers the gun fires of one color into, kept by the
+caller across frames so that rendering does not allocate */
+struct GunFireScratch {
+  std::vector<Point> starts;
+  std::vector<Point> ends;
+};
 
 class GunFire {
 public:
@@ -13,6 +21,9 @@ public:
   /* Render gun fire */
   void Render(Framebuffer& fb, const Point& top_left, const Point& bottom_right);
 
+  /* Render many gun fires, clipping those of the same color together */
+  static void RenderAll(const std::vector<GunFire>& gun_fires, Framebuffer& fb, const Point& top_left, const Point& bottom_right, GunFireScratch& scratch);
+
   /* Move gun fire */
   void Move();
 
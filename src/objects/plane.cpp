@@ -18,6 +18,7 @@ Plane::Plane(const char *file_path, int y_speed) {
 
     plane_file >> x >> y;
     center_ = Point(x, y);
+    body_center_ = center_;
 
     int polygon_count;
     plane_file >> polygon_count;
@@ -35,9 +36,7 @@ Plane::Plane(const char *file_path, int y_speed) {
           plane_file >> x >> y;
           polygon.AddPoint(Point(x, y));
         }
-        body_.polygons_.push_back(polygon);
-        body_.fill_colors_.push_back(Color(fill_r, fill_g, fill_b));
-        body_.border_colors_.push_back(Color(border_r, border_g, border_b));
+        body_.AddPolygon(polygon, Color(fill_r, fill_g, fill_b), Color(border_r, border_g, border_b));
     }
     plane_file.close();
     y_speed_ = y_speed;
@@ -49,14 +48,15 @@ Plane::Plane(const char *file_path, int y_speed) {
 
 /* Scale this plane */
 void Plane::Scale(double scale_factor) {
-  body_.Scale(center_, scale_factor);
+  body_.Scale(body_center_, scale_factor);
   top_left_.Scale(center_, scale_factor);
   bottom_right_.Scale(center_, scale_factor);
 }
 
 /* Render plane */
 void Plane::Render(Framebuffer& fb, const Point& top_left, const Point& bottom_right) {
-  fb.DrawClippedSprite(body_, top_left, bottom_right);
+  Transform2D placement = Transform2D::Translation(Point(center_.GetX() - body_center_.GetX(), center_.GetY() - body_center_.GetY()));
+  fb.DrawClippedSprite(body_, placement, top_left, bottom_right);
 }
 
 /* Setter */
@@ -65,7 +65,6 @@ void Plane::SetCenter(const Point& center) {
   int yoffset = center.GetY() - center_.GetY();
   center_ = center;
 
-  body_.Translate(Point(xoffset, yoffset));
   top_left_.Translate(Point(xoffset, yoffset));
   bottom_right_.Translate(Point(xoffset, yoffset));
 }
@@ -89,9 +88,11 @@ Point Plane::GetBottomRight() const {
 
 /* Check whether the plane collided or not */
 bool Plane::IsCollide(const Framebuffer& fb, const Color& color) {
+  /* Compare against the color as the screen stores it (16 bpp rounds it) */
+  Color screen_color = fb.GetScreenColor(color);
   for (int i = top_left_.GetY(); i <= bottom_right_.GetY(); i++) {
     for (int j = top_left_.GetX(); j <= bottom_right_.GetX(); j++) {
-      if (Color::IsColorSame(fb.GetPixelColor(Point(j, i)), color)) {
+      if (Color::IsColorSame(fb.GetPixelColor(Point(j, i)), screen_color)) {
         return true;
       }
     }
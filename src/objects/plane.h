@@ -3,6 +3,7 @@
 
 #include "../graphics/sprite.h"
 #include "../graphics/point.h"
+#include "../graphics/transform.h"
 #include "../graphics/framebuffer.h"
 #include "../graphics/color.h"
 
@@ -33,6 +34,7 @@ private:
   Point top_left_;
   Point bottom_right_;
 	Point center_;
+  Point body_center_; /* center of body_, which stays where it was loaded and is moved to center_ while drawing */
   Sprite body_;
   int y_speed_;
 };
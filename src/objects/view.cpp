@@ -1,16 +1,20 @@
 #include "view.h"
+#include <algorithm>
+#include <cmath>
 
 /* Constructor */
 View::View(const Point& top_left, const Point& bottom_right, const Color& border_color) {
   top_left_ = top_left;
   bottom_right_ = bottom_right;
   border_color_ = border_color;
+  is_tile_caching_ = false;
 }
 
 /* Setter */
 void View::AddSource(Sprite *sprite) {
   sources_.push_back(sprite);
   is_source_visible_.push_back(true);
+  UpdateTileSources();
 }
 
 void View::SetSourcePosition(const Point& source_top_left, const Point& source_bottom_right) {
@@ -20,6 +24,24 @@ void View::SetSourcePosition(const Point& source_top_left, const Point& source_b
 
 void View::SetVisible(int idx) {
   is_source_visible_[idx] = !is_source_visible_[idx];
+  UpdateTileSources();
+}
+
+void View::SetTileCaching(bool enabled) {
+  is_tile_caching_ = enabled;
+  UpdateTileSources();
+}
+
+/* Hand the visible sources to the tile cache */
+void View::UpdateTileSources() {
+  tiles_.Reset();
+  if (is_tile_caching_) {
+    for (unsigned int i = 0; i < sources_.size(); i++) {
+      if (is_source_visible_[i]) {
+        tiles_.AddSource(sources_[i]);
+      }
+    }
+  }
 }
 
 /* Render this view */
@@ -34,11 +56,28 @@ void View::Render(Framebuffer& fb) {
     if (source_bottom_right_.GetY() != source_top_left_.GetY()) {
       y_scale_factor = (double)(bottom_right_.GetY() - top_left_.GetY()) / (double)(source_bottom_right_.GetY() - source_top_left_.GetY());
     }
+  }
+
+  /* Blend pre-rendered tiles if the cache has a level for this scale */
+  bool is_cached = is_tile_caching_ && tiles_.Draw(fb, source_top_left_, x_scale_factor, y_scale_factor, top_left_, bottom_right_);
+  if (sources_.size() > 0 && !is_cached) {
+    /* Map the source rectangle onto the view while drawing, so the sources are never copied */
+    Transform2D transform = Transform2D::Scaling(source_top_left_, x_scale_factor, y_scale_factor).Then(
+      Transform2D::Translation(Point(top_left_.GetX() - source_top_left_.GetX(), top_left_.GetY() - source_top_left_.GetY())));
+
+    /* Only the polygons near the source rectangle are drawn. The margin keeps
+    the ones that round onto the view border when it shrinks the sources */
+    int x_margin = (int) ceil(1.0 / x_scale_factor) + 1;
+    int y_margin = (int) ceil(1.0 / y_scale_factor) + 1;
+    Point query_top_left(source_top_left_.GetX() - x_margin, source_top_left_.GetY() - y_margin);
+    Point query_bottom_right(source_bottom_right_.GetX() + x_margin, source_bottom_right_.GetY() + y_margin);
+
+    int level = Sprite::GetLevelOfDetailFor(std::max(fabs(x_scale_factor), fabs(y_scale_factor)));
     for (unsigned int i = 0; i < sources_.size(); i++) {
       if (is_source_visible_[i]) {
-        Sprite sprite = Sprite::Translate(Sprite::Scale((*sources_[i]), source_top_left_, x_scale_factor, y_scale_factor),
-          Point(top_left_.GetX() - source_top_left_.GetX(), top_left_.GetY() - source_top_left_.GetY()));
-        fb.DrawClippedSprite(sprite, top_left_, bottom_right_);
+        Sprite source = sources_[i]->GetLevelOfDetail(level);
+        source.FindPolygons(query_top_left, query_bottom_right, candidates_);
+        fb.DrawClippedSprite(source, candidates_.data(), candidates_.size(), transform, top_left_, bottom_right_);
       }
     }
   }
@@ -4,6 +4,8 @@
 #include "../graphics/framebuffer.h"
 #include "../graphics/sprite.h"
 #include "../graphics/point.h"
+#include "../graphics/transform.h"
+#include "../graphics/tile_pyramid.h"
 #include "../graphics/color.h"
 
 #include <vector>
@@ -18,6 +20,10 @@ public:
   void SetSourcePosition(const Point& source_top_left, const Point& source_bottom_right);
   void SetVisible(int idx);
 
+  /* Draw the sources from a cache of pre-rendered tiles (off by default).
+  Only for sources that never change */
+  void SetTileCaching(bool enabled);
+
   /* Render this view */
   void Render(Framebuffer& fb);
 
@@ -29,6 +35,12 @@ private:
   Color border_color_;
   std::vector<Sprite*> sources_;
   std::vector<bool> is_source_visible_;
+  std::vector<int> candidates_; /* polygons of a source near the source rectangle */
+  bool is_tile_caching_;
+  TilePyramid tiles_; /* of the visible sources */
+
+  /* Hand the visible sources to the tile cache */
+  void UpdateTileSources();
 };
 
 #endif
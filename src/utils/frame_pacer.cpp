@@ -0,0 +1,95 @@
+#include "frame_pacer.h"
+#include <errno.h>
+
+#define NANOSECONDS_PER_SECOND 1000000000L
+
+/* Nanoseconds from a to b */
+static long Elapsed(const struct timespec& a, const struct timespec& b) {
+  return (b.tv_sec - a.tv_sec) * NANOSECONDS_PER_SECOND + (b.tv_nsec - a.tv_nsec);
+}
+
+/* Returns t moved by nanoseconds */
+static struct timespec Add(struct timespec t, long nanoseconds) {
+  t.tv_sec += nanoseconds / NANOSECONDS_PER_SECOND;
+  t.tv_nsec += nanoseconds % NANOSECONDS_PER_SECOND;
+  if (t.tv_nsec >= NANOSECONDS_PER_SECOND) {
+    t.tv_sec++;
+    t.tv_nsec -= NANOSECONDS_PER_SECOND;
+  }
+  return t;
+}
+
+/* Constructor */
+FramePacer::FramePacer(int frames_per_second) {
+  SetFramesPerSecond(frames_per_second);
+  Reset();
+}
+
+/* Start the current frame now and forget the missed deadlines */
+void FramePacer::Reset() {
+  clock_gettime(CLOCK_MONOTONIC, &frame_start_);
+  deadline_ = Add(frame_start_, frame_budget_);
+  frame_count_ = 0;
+  missed_deadlines_ = 0;
+  last_work_time_ = 0;
+  last_frame_time_ = 0;
+}
+
+/* Sleep until the end of the current frame and start the next one */
+bool FramePacer::Wait() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  last_work_time_ = Elapsed(frame_start_, now);
+  frame_count_++;
+
+  bool on_time = frame_budget_ == 0 || Elapsed(now, deadline_) >= 0;
+  if (frame_budget_ == 0) {
+    deadline_ = now;
+  } else if (on_time) {
+    /* Absolute deadlines: an early wake up or a signal does not shift the schedule */
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline_, 0) == EINTR) {
+    }
+  } else {
+    missed_deadlines_++;
+    if (Elapsed(deadline_, now) > frame_budget_) {
+      deadline_ = now;
+    }
+  }
+
+  struct timespec next_start = on_time ? deadline_ : now;
+  last_frame_time_ = Elapsed(frame_start_, next_start);
+  frame_start_ = next_start;
+  deadline_ = Add(deadline_, frame_budget_);
+  return on_time;
+}
+
+/* Setter (takes effect from the next frame) */
+void FramePacer::SetFramesPerSecond(int frames_per_second) {
+  frames_per_second_ = frames_per_second > 0 ? frames_per_second : 0;
+  frame_budget_ = frames_per_second_ > 0 ? NANOSECONDS_PER_SECOND / frames_per_second_ : 0;
+}
+
+/* Getter */
+int FramePacer::GetFramesPerSecond() const {
+  return frames_per_second_;
+}
+
+long FramePacer::GetFrameBudget() const {
+  return frame_budget_;
+}
+
+long FramePacer::GetFrameCount() const {
+  return frame_count_;
+}
+
+long FramePacer::GetMissedDeadlines() const {
+  return missed_deadlines_;
+}
+
+long FramePacer::GetLastWorkTime() const {
+  return last_work_time_;
+}
+
+long FramePacer::GetLastFrameTime() const {
+  return last_frame_time_;
+}
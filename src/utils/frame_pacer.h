@@ -0,0 +1,44 @@
+#ifndef FRAME_PACER_H
+#define FRAME_PACER_H
+
+#include <time.h>
+
+/* Paces a loop to a target frame rate by sleeping until absolute deadlines on
+CLOCK_MONOTONIC, so the time spent working counts against the frame budget
+instead of adding to it */
+class FramePacer {
+public:
+  /* Constructor (0 frames per second runs uncapped, for benchmarks) */
+  FramePacer(int frames_per_second);
+
+  /* Start the current frame now and forget the missed deadlines */
+  void Reset();
+
+  /* Sleep until the end of the current frame and start the next one. Returns
+  false if the deadline had already passed. A frame that ends more than a
+  whole frame late moves the schedule instead of rushing the next frames */
+  bool Wait();
+
+  /* Setter (takes effect from the next frame) */
+  void SetFramesPerSecond(int frames_per_second);
+
+  /* Getter */
+  int GetFramesPerSecond() const;
+  long GetFrameBudget() const; /* nanoseconds per frame, 0 when uncapped */
+  long GetFrameCount() const; /* frames ended by Wait() since the last Reset() */
+  long GetMissedDeadlines() const;
+  long GetLastWorkTime() const; /* nanoseconds from the start of the last frame to its Wait() */
+  long GetLastFrameTime() const; /* nanoseconds from the start of the last frame to the start of the next */
+
+private:
+  int frames_per_second_;
+  long frame_budget_;
+  struct timespec frame_start_;
+  struct timespec deadline_;
+  long frame_count_;
+  long missed_deadlines_;
+  long last_work_time_;
+  long last_frame_time_;
+};
+
+#endif
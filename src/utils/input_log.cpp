@@ -0,0 +1,90 @@
+#include "input_log.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#define INPUT_LOG_LEFT_CLICK 1
+
+/* Write a 32 bit number to a header, least significant byte first */
+static void PutUint32(uint8_t *bytes, uint32_t value) {
+  for (int i = 0; i < 4; i++) {
+    bytes[i] = value >> (i * 8);
+  }
+}
+
+/* Read a 32 bit number from a header, least significant byte first */
+static uint32_t GetUint32(const uint8_t *bytes) {
+  return bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | ((uint32_t) bytes[3] << 24);
+}
+
+/* Constructor */
+InputRecorder::InputRecorder(const char *path, unsigned seed) {
+  file_ = fopen(path, "wb");
+  if (!file_) {
+    perror("Error: cannot create input log");
+    exit(9);
+  }
+
+  uint8_t header[12];
+  memcpy(header, INPUT_LOG_MAGIC, 4);
+  PutUint32(header + 4, INPUT_LOG_VERSION);
+  PutUint32(header + 8, seed);
+  fwrite(header, sizeof(header), 1, file_);
+}
+
+/* Destructor */
+InputRecorder::~InputRecorder() {
+  fclose(file_);
+}
+
+/* Append the input of the next frame */
+void InputRecorder::Record(const FrameInput& input) {
+  int16_t x = input.mouse_position.GetX();
+  int16_t y = input.mouse_position.GetY();
+  uint8_t frame[INPUT_LOG_FRAME_SIZE] = {
+    (uint8_t) input.key,
+    (uint8_t) (input.left_click ? INPUT_LOG_LEFT_CLICK : 0),
+    (uint8_t) x, (uint8_t) (x >> 8),
+    (uint8_t) y, (uint8_t) (y >> 8)
+  };
+  fwrite(frame, sizeof(frame), 1, file_);
+}
+
+/* Constructor */
+InputReplayer::InputReplayer(const char *path) {
+  file_ = fopen(path, "rb");
+  if (!file_) {
+    perror("Error: cannot open input log");
+    exit(9);
+  }
+
+  uint8_t header[12];
+  if (fread(header, sizeof(header), 1, file_) != 1 || memcmp(header, INPUT_LOG_MAGIC, 4) != 0 ||
+      GetUint32(header + 4) != INPUT_LOG_VERSION) {
+    fprintf(stderr, "Error: %s is not an input log\n", path);
+    exit(9);
+  }
+  seed_ = GetUint32(header + 8);
+}
+
+/* Destructor */
+InputReplayer::~InputReplayer() {
+  fclose(file_);
+}
+
+/* Read the input of the next frame, returns false at the end of the log */
+bool InputReplayer::Next(FrameInput& input) {
+  uint8_t frame[INPUT_LOG_FRAME_SIZE];
+  if (fread(frame, sizeof(frame), 1, file_) != 1) {
+    return false;
+  }
+  input.key = frame[0];
+  input.left_click = frame[1] & INPUT_LOG_LEFT_CLICK;
+  input.mouse_position = Point((int16_t) (frame[2] | (frame[3] << 8)), (int16_t) (frame[4] | (frame[5] << 8)));
+  return true;
+}
+
+/* Getter */
+unsigned InputReplayer::GetSeed() const {
+  return seed_;
+}
@@ -0,0 +1,57 @@
+#ifndef INPUT_LOG_H
+#define INPUT_LOG_H
+
+#include "../graphics/point.h"
+#include <stdio.h>
+
+/* Input logs are a header (magic, version, random seed) followed by 6 bytes
+per frame: the key, the mouse buttons and the mouse position as two little
+endian 16 bit numbers */
+#define INPUT_LOG_MAGIC "GRIL"
+#define INPUT_LOG_VERSION 1
+#define INPUT_LOG_FRAME_SIZE 6
+
+/* Player input of one frame */
+struct FrameInput {
+  char key;
+  bool left_click;
+  Point mouse_position;
+};
+
+/* Writes the input of a session to a log, frame by frame */
+class InputRecorder {
+public:
+  /* Constructor (creates or truncates the log, seed is what the session passed to srand) */
+  InputRecorder(const char *path, unsigned seed);
+
+  /* Destructor */
+  ~InputRecorder();
+
+  /* Append the input of the next frame */
+  void Record(const FrameInput& input);
+
+private:
+  FILE *file_;
+};
+
+/* Reads back a log written by InputRecorder */
+class InputReplayer {
+public:
+  /* Constructor */
+  InputReplayer(const char *path);
+
+  /* Destructor */
+  ~InputReplayer();
+
+  /* Read the input of the next frame, returns false at the end of the log */
+  bool Next(FrameInput& input);
+
+  /* Getter */
+  unsigned GetSeed() const;
+
+private:
+  FILE *file_;
+  unsigned seed_;
+};
+
+#endif
@@ -1,6 +1,8 @@
 #include "mouse_listener.h"
 #include <unistd.h>
 #include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
 
 /* Constructor */
 MouseListener::MouseListener(const Point& frame_top_left, const Point& frame_bottom_right, const Point& position) {
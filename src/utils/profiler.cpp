@@ -0,0 +1,126 @@
+#include "profiler.h"
+#include <signal.h>
+#include <string.h>
+
+Profiler::Stage Profiler::stages_[PROFILER_MAX_STAGES];
+int Profiler::stage_count_ = 0;
+bool Profiler::enabled_ = false;
+volatile sig_atomic_t Profiler::dump_requested_ = 0;
+
+/* Add a named stage and return its id */
+int Profiler::RegisterStage(const char *name) {
+  if (stage_count_ == PROFILER_MAX_STAGES) {
+    return -1;
+  }
+  Stage& stage = stages_[stage_count_];
+  memset(&stage, 0, sizeof(stage));
+  stage.name = name;
+  return stage_count_++;
+}
+
+/* Add one timing of nanoseconds to a stage */
+void Profiler::Record(int stage, long nanoseconds) {
+  if (!enabled_ || stage < 0 || stage >= stage_count_) {
+    return;
+  }
+  Stage& s = stages_[stage];
+  s.buckets[GetBucket(nanoseconds)]++;
+  s.count++;
+  if (nanoseconds > s.max) {
+    s.max = nanoseconds;
+  }
+}
+
+/* Print the count, p50, p99 and max of every recorded stage */
+void Profiler::Dump(FILE *file) {
+  fprintf(file, "%-16s %10s %12s %12s %12s\n", "stage", "count", "p50_us", "p99_us", "max_us");
+  for (int i = 0; i < stage_count_; i++) {
+    const Stage& stage = stages_[i];
+    if (stage.count == 0) {
+      continue;
+    }
+    fprintf(file, "%-16s %10ld %12.1f %12.1f %12.1f\n", stage.name, stage.count,
+            GetPercentile(stage, 0.50) / 1e3, GetPercentile(stage, 0.99) / 1e3, stage.max / 1e3);
+  }
+  fflush(file);
+}
+
+/* Forget all timings */
+void Profiler::Reset() {
+  for (int i = 0; i < stage_count_; i++) {
+    memset(stages_[i].buckets, 0, sizeof(stages_[i].buckets));
+    stages_[i].count = 0;
+    stages_[i].max = 0;
+  }
+}
+
+/* Make signal_number request a dump */
+void Profiler::DumpOnSignal(int signal_number) {
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = HandleSignal;
+  sigemptyset(&action.sa_mask);
+  action.sa_flags = SA_RESTART;
+  sigaction(signal_number, &action, 0);
+}
+
+/* Dump if a signal asked for it since the last call */
+void Profiler::DumpIfRequested(FILE *file) {
+  if (dump_requested_) {
+    dump_requested_ = 0;
+    Dump(file);
+  }
+}
+
+/* Only sets a flag: stdio is not safe to use in a signal handler */
+void Profiler::HandleSignal(int signal_number) {
+  (void) signal_number;
+  dump_requested_ = 1;
+}
+
+/* Setter */
+void Profiler::SetEnabled(bool enabled) {
+  enabled_ = enabled;
+}
+
+/* Getter */
+bool Profiler::IsEnabled() {
+  return enabled_;
+}
+
+/* Bucket holding nanoseconds */
+int Profiler::GetBucket(long nanoseconds) {
+  if (nanoseconds < PROFILER_LINEAR_BUCKETS) {
+    return nanoseconds > 0 ? nanoseconds : 0;
+  }
+  int exponent = 63 - __builtin_clzl(nanoseconds);
+  int sub_bucket = (nanoseconds >> (exponent - 3)) & (PROFILER_SUB_BUCKETS - 1);
+  return PROFILER_LINEAR_BUCKETS + (exponent - 4) * PROFILER_SUB_BUCKETS + sub_bucket;
+}
+
+/* Largest value of a bucket */
+long Profiler::GetBucketLimit(int bucket) {
+  if (bucket < PROFILER_LINEAR_BUCKETS) {
+    return bucket;
+  }
+  int exponent = (bucket - PROFILER_LINEAR_BUCKETS) / PROFILER_SUB_BUCKETS + 4;
+  long sub_bucket = (bucket - PROFILER_LINEAR_BUCKETS) % PROFILER_SUB_BUCKETS;
+  return ((PROFILER_SUB_BUCKETS + sub_bucket + 1) << (exponent - 3)) - 1;
+}
+
+/* Value under which a fraction of the timings of a stage fall */
+long Profiler::GetPercentile(const Stage& stage, double fraction) {
+  long rank = (long) (fraction * stage.count + 0.5);
+  if (rank < 1) {
+    rank = 1;
+  }
+  long seen = 0;
+  for (int i = 0; i < PROFILER_BUCKETS; i++) {
+    seen += stage.buckets[i];
+    if (seen >= rank) {
+      long limit = GetBucketLimit(i);
+      return limit < stage.max ? limit : stage.max;
+    }
+  }
+  return stage.max;
+}
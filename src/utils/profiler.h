@@ -0,0 +1,99 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+
+#define PROFILER_MAX_STAGES 32
+
+/* Histogram buckets: one per nanosecond below 16 ns, then 8 per power of two,
+so a percentile is within 12.5% of the real value */
+#define PROFILER_LINEAR_BUCKETS 16
+#define PROFILER_SUB_BUCKETS 8
+#define PROFILER_BUCKETS (PROFILER_LINEAR_BUCKETS + (64 - 4) * PROFILER_SUB_BUCKETS)
+
+/* Per stage latency histograms of the frame loop. Everything is preallocated,
+recording only increments counters. Stages are recorded from one thread */
+class Profiler {
+public:
+  /* Add a named stage and return its id (the name is not copied). Returns -1
+  once PROFILER_MAX_STAGES stages exist */
+  static int RegisterStage(const char *name);
+
+  /* Add one timing of nanoseconds to a stage (ignored while disabled) */
+  static void Record(int stage, long nanoseconds);
+
+  /* Print the count, p50, p99 and max of every recorded stage */
+  static void Dump(FILE *file);
+
+  /* Forget all timings */
+  static void Reset();
+
+  /* Make signal_number request a dump, done by the next DumpIfRequested() */
+  static void DumpOnSignal(int signal_number);
+
+  /* Dump if a signal asked for it since the last call */
+  static void DumpIfRequested(FILE *file);
+
+  /* Setter (disabled by default) */
+  static void SetEnabled(bool enabled);
+
+  /* Getter */
+  static bool IsEnabled();
+
+  /* Current CLOCK_MONOTONIC time in nanoseconds */
+  static long Now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000L + ts.tv_nsec;
+  }
+
+private:
+  struct Stage {
+    const char *name;
+    uint32_t buckets[PROFILER_BUCKETS];
+    long count;
+    long max;
+  };
+
+  /* Bucket holding nanoseconds */
+  static int GetBucket(long nanoseconds);
+
+  /* Largest value of a bucket */
+  static long GetBucketLimit(int bucket);
+
+  /* Value under which a fraction of the timings of a stage fall */
+  static long GetPercentile(const Stage& stage, double fraction);
+
+  static void HandleSignal(int signal_number);
+
+  static Stage stages_[PROFILER_MAX_STAGES];
+  static int stage_count_;
+  static bool enabled_;
+  static volatile sig_atomic_t dump_requested_;
+};
+
+/* Records the time between its construction and destruction into a stage */
+class ScopedTimer {
+public:
+  /* Constructor */
+  explicit ScopedTimer(int stage) : stage_(Profiler::IsEnabled() ? stage : -1), start_(stage_ >= 0 ? Profiler::Now() : 0) {}
+
+  /* Destructor */
+  ~ScopedTimer() {
+    if (stage_ >= 0) {
+      Profiler::Record(stage_, Profiler::Now() - start_);
+    }
+  }
+
+private:
+  ScopedTimer(const ScopedTimer&);
+  ScopedTimer& operator=(const ScopedTimer&);
+
+  int stage_;
+  long start_;
+};
+
+#endif
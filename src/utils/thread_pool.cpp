@@ -0,0 +1,94 @@
+#include "thread_pool.h"
+
+/* Constructor */
+ThreadPool::ThreadPool(int worker_count) {
+  task_ = 0;
+  context_ = 0;
+  task_count_ = 0;
+  next_task_ = 0;
+  busy_workers_ = 0;
+  batch_ = 0;
+  stopping_ = false;
+  for (int i = 0; i < worker_count; i++) {
+    workers_.push_back(std::thread(&ThreadPool::WorkerLoop, this));
+  }
+}
+
+/* Destructor */
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  start_condition_.notify_all();
+  for (unsigned int i = 0; i < workers_.size(); i++) {
+    workers_[i].join();
+  }
+}
+
+/* Run task(context, index) for every index in [0, count) on the workers and
+the calling thread, returns when all of them are done */
+void ThreadPool::Run(Task task, void *context, int count) {
+  if (workers_.empty() || count <= 1) {
+    for (int i = 0; i < count; i++) {
+      task(context, i);
+    }
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    task_ = task;
+    context_ = context;
+    task_count_ = count;
+    next_task_ = 0;
+    busy_workers_ = workers_.size();
+    batch_++;
+  }
+  start_condition_.notify_all();
+
+  RunTasks();
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (busy_workers_ > 0) {
+    done_condition_.wait(lock);
+  }
+}
+
+/* Getter */
+int ThreadPool::GetWorkerCount() const {
+  return workers_.size();
+}
+
+/* Wait for batches and help running them until the pool is destroyed */
+void ThreadPool::WorkerLoop() {
+  unsigned long finished_batch = 0;
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      while (!stopping_ && batch_ == finished_batch) {
+        start_condition_.wait(lock);
+      }
+      if (stopping_) {
+        return;
+      }
+      finished_batch = batch_;
+    }
+
+    RunTasks();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    busy_workers_--;
+    if (busy_workers_ == 0) {
+      done_condition_.notify_one();
+    }
+  }
+}
+
+/* Take tasks of the current batch until there is none left */
+void ThreadPool::RunTasks() {
+  int index;
+  while ((index = next_task_++) < task_count_) {
+    task_(context_, index);
+  }
+}
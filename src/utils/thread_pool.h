@@ -0,0 +1,48 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/* Persistent worker threads that run batches of indexed tasks */
+class ThreadPool {
+public:
+  typedef void (*Task)(void *context, int index);
+
+  /* Constructor */
+  ThreadPool(int worker_count);
+
+  /* Destructor */
+  ~ThreadPool();
+
+  /* Run task(context, index) for every index in [0, count) on the workers and
+  the calling thread, returns when all of them are done */
+  void Run(Task task, void *context, int count);
+
+  /* Getter */
+  int GetWorkerCount() const;
+
+private:
+  /* Wait for batches and help running them until the pool is destroyed */
+  void WorkerLoop();
+
+  /* Take tasks of the current batch until there is none left */
+  void RunTasks();
+
+  std::vector<std::thread> workers_;
+  std::mutex mutex_;
+  std::condition_variable start_condition_;
+  std::condition_variable done_condition_;
+  Task task_;
+  void *context_;
+  int task_count_;
+  std::atomic<int> next_task_;
+  int busy_workers_;
+  unsigned long batch_;
+  bool stopping_;
+};
+
+#endif